@@ -66,6 +66,21 @@ void b2BroadPhase::TouchProxy(int32 proxyId)
 	BufferMove(proxyId);
 }
 
+void b2BroadPhase::CopyFrom(const b2BroadPhase& broadPhase)
+{
+	m_tree.CopyFrom(broadPhase.m_tree);
+	m_proxyCount = broadPhase.m_proxyCount;
+
+	if (m_moveCapacity < broadPhase.m_moveCount)
+	{
+		b2Free(m_moveBuffer);
+		m_moveCapacity = broadPhase.m_moveCapacity;
+		m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+	}
+	memcpy(m_moveBuffer, broadPhase.m_moveBuffer, broadPhase.m_moveCount * sizeof(int32));
+	m_moveCount = broadPhase.m_moveCount;
+}
+
 void b2BroadPhase::BufferMove(int32 proxyId)
 {
 	if (m_moveCount == m_moveCapacity)
@@ -65,6 +65,9 @@ public:
 	/// Get user data from a proxy. Returns nullptr if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
 
+	/// Set the user data of a proxy.
+	void SetUserData(int32 proxyId, void* userData);
+
 	/// Test overlap of fat AABBs.
 	bool TestOverlap(int32 proxyIdA, int32 proxyIdB) const;
 
@@ -104,6 +107,10 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Make this broad-phase an exact copy of another one, including the proxies
+	/// waiting for UpdatePairs. The proxy user data is copied as is.
+	void CopyFrom(const b2BroadPhase& broadPhase);
+
 private:
 
 	friend class b2DynamicTree;
@@ -149,6 +156,11 @@ inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 	return m_tree.GetUserData(proxyId);
 }
 
+inline void b2BroadPhase::SetUserData(int32 proxyId, void* userData)
+{
+	m_tree.SetUserData(proxyId, userData);
+}
+
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
 	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
@@ -778,3 +778,21 @@ void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 		m_nodes[i].aabb.upperBound -= newOrigin;
 	}
 }
+
+void b2DynamicTree::CopyFrom(const b2DynamicTree& tree)
+{
+	// Keep the pool when it already has the right size.
+	if (m_nodeCapacity != tree.m_nodeCapacity)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = tree.m_nodeCapacity;
+		m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	}
+	memcpy(m_nodes, tree.m_nodes, m_nodeCapacity * sizeof(b2TreeNode));
+
+	m_root = tree.m_root;
+	m_nodeCount = tree.m_nodeCount;
+	m_freeList = tree.m_freeList;
+	m_path = tree.m_path;
+	m_insertionCount = tree.m_insertionCount;
+}
@@ -20,6 +20,7 @@
 #include <limits.h>
 #include <string.h>
 #include <stddef.h>
+#include <mutex>
 
 int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] = 
 {
@@ -40,6 +41,7 @@ int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] =
 };
 uint8 b2BlockAllocator::s_blockSizeLookup[b2_maxBlockSize + 1];
 bool b2BlockAllocator::s_blockSizeLookupInitialized;
+static std::once_flag s_blockSizeLookupOnce;
 
 struct b2Chunk
 {
@@ -63,7 +65,8 @@ b2BlockAllocator::b2BlockAllocator()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
 
-	if (s_blockSizeLookupInitialized == false)
+	// Allocators may be created on several threads at once.
+	std::call_once(s_blockSizeLookupOnce, []
 	{
 		int32 j = 0;
 		for (int32 i = 1; i <= b2_maxBlockSize; ++i)
@@ -81,7 +84,7 @@ b2BlockAllocator::b2BlockAllocator()
 		}
 
 		s_blockSizeLookupInitialized = true;
-	}
+	});
 }
 
 b2BlockAllocator::~b2BlockAllocator()
@@ -100,6 +100,53 @@ public:
 	/// Draw a point.
 	virtual void DrawPoint(const b2Vec2& p, float32 size, const b2Color& color) = 0;
 
+    /// Upload a triangle list given in body-local space once, so it can be drawn every frame
+    /// with DrawMesh. When worldTextureCoordinates is set the texture coordinates are derived
+    /// from the world position instead. Returns 0 if retained meshes are not supported.
+    virtual uint32 CreateMesh(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, bool worldTextureCoordinates)
+    {
+        B2_NOT_USED(vertices);
+        B2_NOT_USED(textureCoordinates);
+        B2_NOT_USED(vertexCount);
+        B2_NOT_USED(worldTextureCoordinates);
+        return 0;
+    }
+
+    /// Release a mesh returned by CreateMesh.
+    virtual void DestroyMesh(uint32 meshId)
+    {
+        B2_NOT_USED(meshId);
+    }
+
+    /// Draw a mesh returned by CreateMesh with the given body transform.
+    virtual void DrawMesh(uint32 meshId, const b2Transform& xf, const b2Color& color, uint32 glTexId, int matTexId)
+    {
+        B2_NOT_USED(meshId);
+        B2_NOT_USED(xf);
+        B2_NOT_USED(color);
+        B2_NOT_USED(glTexId);
+        B2_NOT_USED(matTexId);
+    }
+
+    /// Static bodies may be drawn once into a cached background layer. Call first in a frame.
+    /// Returns true when the layer has to be redrawn because key changed since it was cached;
+    /// the draws up to EndStaticLayer then go into the layer. Returns false when the cached
+    /// layer was drawn instead.
+    virtual bool BeginStaticLayer(uint32 key)
+    {
+        B2_NOT_USED(key);
+        return true;
+    }
+
+    /// Finish drawing the static layer started by BeginStaticLayer and draw it.
+    virtual void EndStaticLayer() {}
+
+    /// Instance id the following draws write into the segmentation mask, 0 for none.
+    virtual void SetInstanceId(uint32 id)
+    {
+        B2_NOT_USED(id);
+    }
+
 protected:
 	uint32 m_drawFlags;
 };
@@ -34,8 +34,11 @@
 #include "Box2D/Dynamics/b2Fixture.h"
 #include "Box2D/Dynamics/b2World.h"
 
+#include <mutex>
+
 b2ContactRegister b2Contact::s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 bool b2Contact::s_initialized = false;
+static std::once_flag s_registersOnce;
 
 void b2Contact::InitializeRegisters()
 {
@@ -68,11 +71,12 @@ void b2Contact::AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* dest
 
 b2Contact* b2Contact::Create(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB, b2BlockAllocator* allocator)
 {
-	if (s_initialized == false)
+	// Worlds may be stepped on several threads at once.
+	std::call_once(s_registersOnce, []
 	{
 		InitializeRegisters();
 		s_initialized = true;
-	}
+	});
 
 	b2Shape::Type type1 = fixtureA->GetType();
 	b2Shape::Type type2 = fixtureB->GetType();
@@ -33,6 +33,8 @@
 #include "Box2D/Common/b2Draw.h"
 #include "Box2D/Common/b2Timer.h"
 #include <new>
+#include <unordered_map>
+#include <vector>
 
 b2World::b2World(const b2Vec2& gravity)
 {
@@ -1306,6 +1308,202 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 }
 
+b2World* b2World::Clone() const
+{
+	b2Assert(IsLocked() == false);
+	b2Assert(m_jointCount == 0);
+	if (IsLocked() || m_jointCount > 0)
+	{
+		return nullptr;
+	}
+
+	b2World* world = new b2World(m_gravity);
+	world->CopyFrom(*this);
+	return world;
+}
+
+void b2World::Restore(const b2World& snapshot)
+{
+	b2Assert(IsLocked() == false);
+	b2Assert(snapshot.m_jointCount == 0);
+	if (IsLocked() || snapshot.m_jointCount > 0)
+	{
+		return;
+	}
+
+	// The freed bodies, fixtures and contacts go back to the block allocator,
+	// the copies are allocated from the same blocks.
+	b2DestructionListener* destructionListener = m_destructionListener;
+	b2ContactListener* contactListener = m_contactManager.m_contactListener;
+	m_destructionListener = nullptr;
+	m_contactManager.m_contactListener = nullptr;
+
+	while (m_bodyList)
+	{
+		DestroyBody(m_bodyList);
+	}
+
+	m_destructionListener = destructionListener;
+	m_contactManager.m_contactListener = contactListener;
+
+	CopyFrom(snapshot);
+}
+
+void b2World::CopyFrom(const b2World& world)
+{
+	b2Assert(m_bodyCount == 0 && m_jointCount == 0 && m_contactManager.m_contactCount == 0);
+
+	m_flags = world.m_flags & ~e_locked;
+	m_gravity = world.m_gravity;
+	m_allowSleep = world.m_allowSleep;
+	m_inv_dt0 = world.m_inv_dt0;
+	m_warmStarting = world.m_warmStarting;
+	m_continuousPhysics = world.m_continuousPhysics;
+	m_subStepping = world.m_subStepping;
+	m_stepComplete = world.m_stepComplete;
+
+	// Bodies and contacts are prepended to their lists, so they are created from the tail.
+	std::vector<const b2Body*> sources;
+	sources.reserve(world.m_bodyCount);
+	for (const b2Body* s = world.m_bodyList; s; s = s->m_next)
+	{
+		sources.push_back(s);
+	}
+
+	std::vector<b2Body*> bodies(sources.size());
+	std::unordered_map<const b2Fixture*, b2Fixture*> fixtures;
+	for (int32 i = (int32)sources.size() - 1; i >= 0; --i)
+	{
+		const b2Body* s = sources[i];
+
+		b2BodyDef bd;
+		bd.type = s->m_type;
+		bd.position = s->m_xf.p;
+		bd.angle = s->m_sweep.a;
+		b2Body* b = CreateBody(&bd);
+		CopyBodyState(b, s);
+		bodies[i] = b;
+
+		// The proxies are not inserted, the broad-phase tree is copied below.
+		b2Fixture** fixtureNext = &b->m_fixtureList;
+		for (const b2Fixture* sf = s->m_fixtureList; sf; sf = sf->m_next)
+		{
+			b2FixtureDef fd;
+			fd.shape = sf->m_shape;
+			fd.userData = sf->m_userData;
+			fd.friction = sf->m_friction;
+			fd.restitution = sf->m_restitution;
+			fd.density = sf->m_density;
+			fd.isSensor = sf->m_isSensor;
+			fd.filter = sf->m_filter;
+
+			void* mem = m_blockAllocator.Allocate(sizeof(b2Fixture));
+			b2Fixture* f = new (mem) b2Fixture;
+			f->Create(&m_blockAllocator, b, &fd);
+
+			f->m_proxyCount = sf->m_proxyCount;
+			for (int32 j = 0; j < sf->m_proxyCount; ++j)
+			{
+				f->m_proxies[j] = sf->m_proxies[j];
+				f->m_proxies[j].fixture = f;
+			}
+
+			*fixtureNext = f;
+			fixtureNext = &f->m_next;
+			++b->m_fixtureCount;
+			fixtures[sf] = f;
+		}
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->CopyFrom(world.m_contactManager.m_broadPhase);
+	for (const auto& fixture : fixtures)
+	{
+		b2Fixture* f = fixture.second;
+		for (int32 j = 0; j < f->m_proxyCount; ++j)
+		{
+			broadPhase->SetUserData(f->m_proxies[j].proxyId, f->m_proxies + j);
+		}
+	}
+
+	std::vector<const b2Contact*> sourceContacts;
+	sourceContacts.reserve(world.m_contactManager.m_contactCount);
+	for (const b2Contact* sc = world.m_contactManager.m_contactList; sc; sc = sc->m_next)
+	{
+		sourceContacts.push_back(sc);
+	}
+
+	// The fixtures of a contact are already in the order Create keeps, the manifold
+	// holds the impulses used for warm starting.
+	std::unordered_map<const b2Contact*, b2Contact*> contacts;
+	for (int32 i = (int32)sourceContacts.size() - 1; i >= 0; --i)
+	{
+		const b2Contact* sc = sourceContacts[i];
+		b2Contact* c = b2Contact::Create(fixtures[sc->m_fixtureA], sc->m_indexA,
+										 fixtures[sc->m_fixtureB], sc->m_indexB, &m_blockAllocator);
+		c->m_flags = sc->m_flags;
+		c->m_manifold = sc->m_manifold;
+		c->m_toiCount = sc->m_toiCount;
+		c->m_toi = sc->m_toi;
+		c->m_friction = sc->m_friction;
+		c->m_restitution = sc->m_restitution;
+		c->m_tangentSpeed = sc->m_tangentSpeed;
+
+		c->m_nodeA.contact = c;
+		c->m_nodeA.other = c->m_fixtureB->m_body;
+		c->m_nodeB.contact = c;
+		c->m_nodeB.other = c->m_fixtureA->m_body;
+
+		c->m_prev = nullptr;
+		c->m_next = m_contactManager.m_contactList;
+		if (m_contactManager.m_contactList != nullptr)
+		{
+			m_contactManager.m_contactList->m_prev = c;
+		}
+		m_contactManager.m_contactList = c;
+		++m_contactManager.m_contactCount;
+		contacts[sc] = c;
+	}
+
+	// Rebuild the contact edges of each body in the order of the source body.
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		b2ContactEdge* prev = nullptr;
+		b2ContactEdge** next = &bodies[i]->m_contactList;
+		for (const b2ContactEdge* se = sources[i]->m_contactList; se; se = se->next)
+		{
+			b2Contact* c = contacts[se->contact];
+			b2ContactEdge* edge = se == &se->contact->m_nodeA ? &c->m_nodeA : &c->m_nodeB;
+			edge->prev = prev;
+			edge->next = nullptr;
+			*next = edge;
+			next = &edge->next;
+			prev = edge;
+		}
+	}
+}
+
+void b2World::CopyBodyState(b2Body* body, const b2Body* source)
+{
+	body->m_flags = source->m_flags;
+	body->m_islandIndex = source->m_islandIndex;
+	body->m_xf = source->m_xf;
+	body->m_sweep = source->m_sweep;
+	body->m_linearVelocity = source->m_linearVelocity;
+	body->m_angularVelocity = source->m_angularVelocity;
+	body->m_force = source->m_force;
+	body->m_torque = source->m_torque;
+	body->m_mass = source->m_mass;
+	body->m_invMass = source->m_invMass;
+	body->m_I = source->m_I;
+	body->m_invI = source->m_invI;
+	body->m_linearDamping = source->m_linearDamping;
+	body->m_angularDamping = source->m_angularDamping;
+	body->m_gravityScale = source->m_gravityScale;
+	body->m_sleepTime = source->m_sleepTime;
+	body->m_userData = source->m_userData;
+}
+
 void b2World::Dump()
 {
 	if ((m_flags & e_locked) == e_locked)
@@ -199,6 +199,20 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Create a deep copy of the world: bodies, fixtures, contacts with their warm starting
+	/// impulses, the broad-phase tree and the sleep timers, so that stepping both worlds gives
+	/// the same results. The bodies are in the same order in both body lists. Body and fixture
+	/// user data is copied as is, listeners and the debug draw are not copied.
+	/// Joints are not supported, nullptr is returned for worlds that have any.
+	/// @warning This function is locked during callbacks.
+	virtual b2World* Clone() const;
+
+	/// Replace the state of this world by the state of a snapshot made by Clone on a world
+	/// of the same class. The memory of the current bodies, fixtures and contacts is reused.
+	/// Listeners and the debug draw are kept, no destruction or end contact callbacks are made.
+	/// @warning This function is locked during callbacks.
+	void Restore(const b2World& snapshot);
+
 	/// Get the contact manager for testing.
 	const b2ContactManager& GetContactManager() const;
 
@@ -230,6 +244,12 @@ protected:
 	void DrawJoint(b2Joint* joint);
 	virtual void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
+	// Copies the state of an empty world from another one, see Clone.
+	void CopyFrom(const b2World& world);
+
+	// Copies the state of a body that is not tied to its fixtures, contacts or the world lists.
+	virtual void CopyBodyState(b2Body* body, const b2Body* source);
+
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
@@ -11,6 +11,8 @@
 b2VisBody::b2VisBody(const b2BodyDef* bd, b2World* world) : b2Body(bd, world)
 {
     m_nUniqueId = -1;
+    m_nMeshId = 0;
+    m_nMeshFixtureCount = -1;
     setColor(b2Color(1.0f, 1.0f, 1.0f, 1.0f));
 }
 
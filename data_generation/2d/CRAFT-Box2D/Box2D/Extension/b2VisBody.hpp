@@ -38,9 +38,16 @@ public:
     void setUniqueId(const int& id);
     
 private:
+    friend class b2VisWorld;
+    
     int m_nUniqueId;
     b2Color m_Color;
     b2VisTexture::Ptr m_pTexture;
+    
+    // Retained mesh of the textured fixtures, built by b2VisWorld on the first draw.
+    // m_nMeshFixtureCount is the fixture count it was built for, -1 before the first attempt.
+    uint32 m_nMeshId;
+    int32 m_nMeshFixtureCount;
 };
 
 
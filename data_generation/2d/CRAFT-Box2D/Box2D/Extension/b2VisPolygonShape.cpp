@@ -21,9 +21,14 @@ b2VisPolygonShape::~b2VisPolygonShape()
 std::vector<b2Vec2> b2VisPolygonShape::getTextureCoords() const
 {
     std::vector<b2Vec2> res(m_count);
+    getTextureCoords(res.data());
+    return res;
+}
+
+void b2VisPolygonShape::getTextureCoords(b2Vec2* texCoords) const
+{
     for (int32 i = 0; i < m_count; ++i)
     {
-        res[i] = b2Vec2(m_vertices[i].x / TEXTURE_SQUARE_EDGE_LENGTH, m_vertices[i].y / TEXTURE_SQUARE_EDGE_LENGTH);
+        texCoords[i] = b2Vec2(m_vertices[i].x / TEXTURE_SQUARE_EDGE_LENGTH, m_vertices[i].y / TEXTURE_SQUARE_EDGE_LENGTH);
     }
-    return res;
 }
@@ -18,6 +18,9 @@ public:
     virtual ~b2VisPolygonShape();
     
     std::vector<b2Vec2> getTextureCoords() const;
+    
+    // Fills m_count texture coordinates without allocating.
+    void getTextureCoords(b2Vec2* texCoords) const;
 };
 
 
@@ -183,7 +183,113 @@ b2VisTexture::b2VisTexture(const std::string& filePath, const int& materialIndex
 
 b2VisTexture::b2VisTexture(const int& materialIndex) 
 {
+    m_bOwner = false;
+    m_nTexId = 0;
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_nAtlasWidth = 0;
+    m_nAtlasHeight = 0;
+    m_nMaterialIndex = materialIndex;
+}
+
+b2VisTexture::b2VisTexture(const std::vector<std::string>& filePaths)
+{
+    const int layerCount = (int)filePaths.size();
+    std::vector<GLubyte*> images(layerCount, nullptr);
+    std::vector<bool> imageHasAlpha(layerCount, false);
+    int width = 0;
+    int height = 0;
+    
+    for (int i = 0; i < layerCount; ++i)
+    {
+        if (filePaths[i].empty())
+            continue;
+        
+        int imageWidth, imageHeight;
+        bool hasAlpha;
+        GLubyte* image;
+        if (!loadPngImage(filePaths[i].c_str(), imageWidth, imageHeight, hasAlpha, &image)) {
+            fprintf(stderr, "Could not load %s\n", filePaths[i].c_str());
+            continue;
+        }
+        
+        if (width == 0) {
+            width = imageWidth;
+            height = imageHeight;
+        }
+        if (imageWidth != width || imageHeight != height) {
+            fprintf(stderr, "%s is not %dx%d like the other layers\n", filePaths[i].c_str(), width, height);
+            free(image);
+            continue;
+        }
+        
+        images[i] = image;
+        imageHasAlpha[i] = hasAlpha;
+    }
+    
+    if (width == 0) {
+        width = 1;
+        height = 1;
+    }
+    
+    const int layerSize = 4 * width * height;
+    std::vector<GLubyte> layers(layerSize * layerCount);
+    for (int i = 0; i < layerCount; ++i)
+    {
+        GLubyte* layer = layers.data() + i * layerSize;
+        for (int j = 0; j < width * height; ++j)
+        {
+            if (images[i] == nullptr) {
+                layer[4 * j + 0] = 0;
+                layer[4 * j + 1] = 255;
+                layer[4 * j + 2] = 0;
+                layer[4 * j + 3] = 255;
+            }
+            else if (imageHasAlpha[i]) {
+                memcpy(layer + 4 * j, images[i] + 4 * j, 4);
+            }
+            else {
+                memcpy(layer + 4 * j, images[i] + 3 * j, 3);
+                layer[4 * j + 3] = 255;
+            }
+        }
+        free(images[i]);
+    }
+    
+    GLuint texId;
+    glGenTextures(1, &texId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, layers.data());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    
+    m_bOwner = true;
+    m_nTexId = texId;
+    m_nWidth = width;
+    m_nHeight = height;
+    m_nAtlasWidth = width;
+    m_nAtlasHeight = height;
+    m_vUpperLeftCornerCoord = b2Vec2(0.0f, 0.0f);
+    m_vLowerRightCornerCoord = b2Vec2(m_nWidth-1, m_nHeight-1);
+    m_nMaterialIndex = -1;
+}
+
+b2VisTexture::b2VisTexture(const Ptr& textureArray, const int& materialIndex)
+{
+    m_bOwner = false;
+    m_nTexId = textureArray->getTextureId();
+    m_nWidth = textureArray->getWidth();
+    m_nHeight = textureArray->getHeight();
+    m_nAtlasWidth = textureArray->getAtlasWidth();
+    m_nAtlasHeight = textureArray->getAtlasHeight();
+    m_vUpperLeftCornerCoord = textureArray->getUpperLeftCornerCoord();
+    m_vLowerRightCornerCoord = textureArray->getLowerRightCornerCoord();
     m_nMaterialIndex = materialIndex;
+    m_pTextureArray = textureArray;
 }
 
 b2VisTexture::~b2VisTexture()
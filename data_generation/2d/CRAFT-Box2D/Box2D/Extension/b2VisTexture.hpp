@@ -11,6 +11,7 @@
 #include "Box2D/Common/b2Math.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 class b2VisTexture
 {
@@ -20,6 +21,16 @@ public:
     b2VisTexture(const int& materialIndex);
     virtual ~b2VisTexture();
     
+    typedef std::shared_ptr<b2VisTexture> Ptr;
+    
+    // Loads the images into the layers of one GL_TEXTURE_2D_ARRAY, layer i holding filePaths[i].
+    // Empty paths become a layer of the chroma key green, which is drawn in the body colour.
+    // Every layer takes the size of the first image.
+    b2VisTexture(const std::vector<std::string>& filePaths);
+    
+    // A material stored in layer materialIndex of a texture array.
+    b2VisTexture(const Ptr& textureArray, const int& materialIndex);
+    
     //Getters
     unsigned int getTextureId() const;
     int getWidth() const;
@@ -30,8 +41,6 @@ public:
     b2Vec2 getLowerRightCornerCoord() const;
     int getMaterialIndex() const;
     
-    typedef std::shared_ptr<b2VisTexture> Ptr;
-    
 private:
     bool m_bOwner;
     unsigned int m_nTexId;
@@ -43,6 +52,7 @@ private:
     b2Vec2 m_vUpperLeftCornerCoord;
     b2Vec2 m_vLowerRightCornerCoord;
     int m_nMaterialIndex;
+    Ptr m_pTextureArray;
 };
 
 #endif /* b2VisTexture_hpp */
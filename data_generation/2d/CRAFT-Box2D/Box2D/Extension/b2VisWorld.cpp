@@ -6,6 +6,7 @@
 //
 
 #include "b2VisWorld.hpp"
+#include "b2VisDefines.h"
 #include "Box2D/Extension/b2VisBody.hpp"
 #include "Box2D/Extension/b2VisPolygonShape.hpp"
 #include "Box2D/Dynamics/b2World.h"
@@ -25,6 +26,8 @@
 #include "Box2D/Common/b2Draw.h"
 #include "Box2D/Common/b2Timer.h"
 
+#include <vector>
+
 
 b2VisWorld::b2VisWorld(const b2Vec2& gravity) : b2World(gravity)
 {
@@ -33,7 +36,11 @@ b2VisWorld::b2VisWorld(const b2Vec2& gravity) : b2World(gravity)
 
 b2VisWorld::~b2VisWorld()
 {
-    
+    // b2World frees the bodies without running their destructors.
+    for (b2VisBody* b = (b2VisBody*) m_bodyList; b; b = (b2VisBody*) b->GetNext())
+    {
+        DestroyBodyMesh(b);
+    }
 }
 
 b2Body* b2VisWorld::CreateBody(const b2BodyDef* def)
@@ -137,10 +144,36 @@ void b2VisWorld::DestroyBody(b2Body* b)
     }
 
     --m_bodyCount;
+    DestroyBodyMesh((b2VisBody*)b);
     ((b2VisBody*)b)->~b2VisBody();
     m_blockAllocator.Free(b, sizeof(b2VisBody));
 }
 
+b2World* b2VisWorld::Clone() const
+{
+    b2Assert(IsLocked() == false);
+    b2Assert(m_jointCount == 0);
+    if (IsLocked() || m_jointCount > 0)
+    {
+        return nullptr;
+    }
+
+    b2VisWorld* world = new b2VisWorld(m_gravity);
+    world->CopyFrom(*this);
+    return world;
+}
+
+void b2VisWorld::CopyBodyState(b2Body* body, const b2Body* source)
+{
+    b2World::CopyBodyState(body, source);
+
+    b2VisBody* b = (b2VisBody*)body;
+    const b2VisBody* s = (const b2VisBody*)source;
+    b->m_nUniqueId = s->m_nUniqueId;
+    b->m_Color = s->m_Color;
+    b->m_pTexture = s->m_pTexture;
+}
+
 void b2VisWorld::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
     switch (fixture->GetType())
@@ -219,14 +252,15 @@ void b2VisWorld::DrawTexturedShape(b2Fixture* fixture, const b2Transform& xf, co
             int32 vertexCount = poly->m_count;
             b2Assert(vertexCount <= b2_maxPolygonVertices);
             b2Vec2 vertices[b2_maxPolygonVertices];
+            b2Vec2 texCoords[b2_maxPolygonVertices];
 
             for (int32 i = 0; i < vertexCount; ++i)
             {
                 vertices[i] = b2Mul(xf, poly->m_vertices[i]);
             }
-            std::vector<b2Vec2> texCoords = poly->getTextureCoords();
+            poly->getTextureCoords(texCoords);
             
-            m_debugDraw->DrawTexturedPolygon(vertices, texCoords.data(), vertexCount, color, glTextureId, textureMaterialId);
+            m_debugDraw->DrawTexturedPolygon(vertices, texCoords, vertexCount, color, glTextureId, textureMaterialId);
         }
         break;
             
@@ -300,11 +334,184 @@ void b2VisWorld::DrawTexturedShape(b2Fixture* fixture, const b2Transform& xf, co
     }
 }
 
+// Writes the two triangles of a chain segment drawn as a rectangle of the given width.
+static void sAppendChainSegment(std::vector<b2Vec2>& vertices, const b2Vec2& p1, const b2Vec2& p2, float width)
+{
+    b2Vec2 d = p2 - p1;
+    d.Normalize();
+    const b2Vec2 p = 0.5f * width * b2Vec2(-d.y, d.x);
+    
+    const b2Vec2 quad[4] = { p1 + p, p2 + p, p2 - p, p1 - p };
+    const int32 indices[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int32 i = 0; i < 6; ++i)
+    {
+        vertices.push_back(quad[indices[i]]);
+    }
+}
+
+// Triangulates the fixtures in body space the same way DrawTexturedShape does. Polygons are
+// textured in body space and chains in world space, so a body mixing them, or using any other
+// shape, gets no mesh and is drawn per frame.
+uint32 b2VisWorld::CreateBodyMesh(b2VisBody* body)
+{
+    std::vector<b2Vec2> vertices;
+    int32 polygonCount = 0;
+    int32 chainCount = 0;
+    
+    for (b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+    {
+        switch (f->GetType())
+        {
+        case b2Shape::e_polygon:
+            {
+                b2PolygonShape* poly = (b2PolygonShape*)f->GetShape();
+                for (int32 i = 1; i < poly->m_count - 1; ++i)
+                {
+                    vertices.push_back(poly->m_vertices[0]);
+                    vertices.push_back(poly->m_vertices[i]);
+                    vertices.push_back(poly->m_vertices[i + 1]);
+                }
+                ++polygonCount;
+            }
+            break;
+            
+        case b2Shape::e_chain:
+            {
+                float width = 0.1f;
+                
+                b2ChainShape* chain = (b2ChainShape*)f->GetShape();
+                for (int32 i = 1; i < chain->m_count; ++i)
+                {
+                    sAppendChainSegment(vertices, chain->m_vertices[i - 1], chain->m_vertices[i], width);
+                }
+                ++chainCount;
+            }
+            break;
+            
+        default:
+            return 0;
+        }
+    }
+    
+    if (vertices.empty() || (polygonCount > 0 && chainCount > 0))
+    {
+        return 0;
+    }
+    
+    std::vector<b2Vec2> texCoords(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        texCoords[i] = b2Vec2(vertices[i].x / TEXTURE_SQUARE_EDGE_LENGTH, vertices[i].y / TEXTURE_SQUARE_EDGE_LENGTH);
+    }
+    
+    return m_debugDraw->CreateMesh(vertices.data(), texCoords.data(), (int32)vertices.size(), chainCount > 0);
+}
+
+void b2VisWorld::DestroyBodyMesh(b2VisBody* body)
+{
+    if (body->m_nMeshId && m_debugDraw)
+    {
+        m_debugDraw->DestroyMesh(body->m_nMeshId);
+    }
+    body->m_nMeshId = 0;
+    body->m_nMeshFixtureCount = -1;
+}
+
+void b2VisWorld::DrawTexturedBody(b2VisBody* body, const b2Color& color)
+{
+    const auto texture = body->getTexture();
+    const b2Transform& xf = body->GetTransform();
+    
+    // Fixtures are only ever added or removed, never changed in place.
+    if (body->m_nMeshFixtureCount != body->m_fixtureCount)
+    {
+        DestroyBodyMesh(body);
+        body->m_nMeshId = CreateBodyMesh(body);
+        body->m_nMeshFixtureCount = body->m_fixtureCount;
+    }
+    
+    if (body->m_nMeshId)
+    {
+        m_debugDraw->DrawMesh(body->m_nMeshId, xf, color, texture->getTextureId(), texture->getMaterialIndex());
+        return;
+    }
+    
+    for (b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+    {
+        DrawTexturedShape(f, xf, color, texture->getTextureId(), texture->getMaterialIndex());
+    }
+}
+
 b2Draw* b2VisWorld::getRenderer()
 {
     return m_debugDraw;
 }
 
+void b2VisWorld::DrawBody(b2VisBody* body)
+{
+    // Sensors have no unique id and are left out of the mask like the background.
+    m_debugDraw->SetInstanceId(uint32(body->getUniqueId() + 1));
+    
+    const auto texture = body->getTexture();
+    if (body->IsActive() == false)
+    {
+        DrawTexturedBody(body, b2Color(0.5f, 0.5f, 0.3f));
+    }
+    else if (texture)
+    {
+        DrawTexturedBody(body, body->getColor());
+    }
+    else
+    {
+        const b2Transform& xf = body->GetTransform();
+        const b2Color color = body->GetType() == b2_kinematicBody ? b2Color(0.5f, 0.5f, 0.9f) : body->getColor();
+        for (b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+        {
+            DrawShape(f, xf, color);
+        }
+    }
+    
+    m_debugDraw->SetInstanceId(0);
+}
+
+// FNV-1a
+static uint32 sHash(uint32 hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32 b2VisWorld::GetStaticBodiesKey() const
+{
+    uint32 key = 2166136261u;
+    for (b2VisBody* b = (b2VisBody*) m_bodyList; b; b = (b2VisBody*) b->GetNext())
+    {
+        if (b->GetType() != b2_staticBody)
+        {
+            continue;
+        }
+        
+        const auto texture = b->getTexture();
+        const unsigned int textureId = texture ? texture->getTextureId() : 0;
+        const int materialIndex = texture ? texture->getMaterialIndex() : -1;
+        const bool active = b->IsActive();
+        
+        key = sHash(key, &b, sizeof(b));
+        key = sHash(key, &b->m_fixtureList, sizeof(b->m_fixtureList));
+        key = sHash(key, &b->m_fixtureCount, sizeof(b->m_fixtureCount));
+        key = sHash(key, &b->GetTransform(), sizeof(b2Transform));
+        key = sHash(key, &b->m_Color, sizeof(b->m_Color));
+        key = sHash(key, &textureId, sizeof(textureId));
+        key = sHash(key, &materialIndex, sizeof(materialIndex));
+        key = sHash(key, &active, sizeof(active));
+    }
+    return key;
+}
+
 void b2VisWorld::DrawDebugData()
 {
     if (m_debugDraw == nullptr)
@@ -316,49 +523,24 @@ void b2VisWorld::DrawDebugData()
 
     if (flags & b2Draw::e_shapeBit)
     {
-        for (b2VisBody* b = (b2VisBody*) m_bodyList; b; b = (b2VisBody*) b->GetNext())
+        // The renderer keeps the static bodies in a background layer until one of them changes.
+        if (m_debugDraw->BeginStaticLayer(GetStaticBodiesKey()))
         {
-            const b2Transform& xf = b->GetTransform();
-            for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+            for (b2VisBody* b = (b2VisBody*) m_bodyList; b; b = (b2VisBody*) b->GetNext())
             {
-                const auto texture = b->getTexture();
-                if (b->IsActive() == false)
+                if (b->GetType() == b2_staticBody)
                 {
-                    DrawTexturedShape(f, xf, b2Color(0.5f, 0.5f, 0.3f), texture->getTextureId(), texture->getMaterialIndex());
+                    DrawBody(b);
                 }
-                else if (b->GetType() == b2_staticBody)
-                {
-                    if(texture) {
-                        DrawTexturedShape(f, xf, b->getColor(), texture->getTextureId(), texture->getMaterialIndex());
-                    } else {
-                        DrawShape(f, xf, b->getColor());
-                    }
-                }
-                else if (b->GetType() == b2_kinematicBody)
-                {
-                    if(texture) {
-                          DrawTexturedShape(f, xf, b->getColor(), texture->getTextureId(), texture->getMaterialIndex());
-                      } else {
-                          DrawShape(f, xf, b2Color(0.5f, 0.5f, 0.9f));
-                      }
-                }
-//                else if (b->IsAwake() == false)
-                else
-                {
-                    if(texture) {
-                        DrawTexturedShape(f, xf, b->getColor(), texture->getTextureId(), texture->getMaterialIndex());
-                    } else {
-                        DrawShape(f, xf, b->getColor());
-                    }
-                }
-//                else
-//                {
-//                    if(texture) {
-//                        DrawTexturedShape(f, xf, b2Color(0.9f, 0.7f, 0.7f), texture->getTextureId(), texture->getMaterialIndex());
-//                    } else {
-//                        DrawShape(f, xf, b->getColor());
-//                    }
-//                }
+            }
+            m_debugDraw->EndStaticLayer();
+        }
+        
+        for (b2VisBody* b = (b2VisBody*) m_bodyList; b; b = (b2VisBody*) b->GetNext())
+        {
+            if (b->GetType() != b2_staticBody)
+            {
+                DrawBody(b);
             }
         }
     }
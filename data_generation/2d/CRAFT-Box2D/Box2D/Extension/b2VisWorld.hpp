@@ -10,6 +10,8 @@
 
 #include "Box2D/Dynamics/b2World.h"
 
+class b2VisBody;
+
 class b2VisWorld : public b2World
 {
 public:
@@ -27,16 +29,35 @@ public:
     /// @warning This function is locked during callbacks.
     virtual void DestroyBody(b2Body* body) override;
     
+    /// Create a deep copy of the world, see b2World::Clone. The bodies keep their
+    /// unique ids, colors and textures, their meshes are built again on the first draw.
+    virtual b2World* Clone() const override;
+    
     /// Call this to draw shapes and other debug draw data. This is intentionally non-const.
     virtual void DrawDebugData() override;
     
     virtual void DrawTexturedShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color, const uint32& glTextureId, const int& textureMaterialId);
     
+    /// Draws all fixtures of a textured body. The fixtures are uploaded to the renderer once
+    /// as a body-space mesh and only the transform is sent afterwards.
+    virtual void DrawTexturedBody(b2VisBody* body, const b2Color& color);
+    
     virtual void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color) override;
     
     //Gets the renderer to outside world
     virtual b2Draw* getRenderer();
 
+protected:
+    virtual void CopyBodyState(b2Body* body, const b2Body* source) override;
+
+private:
+    void DrawBody(b2VisBody* body);
+    
+    // Changes whenever a static body is added, removed, moved or restyled.
+    uint32 GetStaticBodiesKey() const;
+    
+    uint32 CreateBodyMesh(b2VisBody* body);
+    void DestroyBodyMesh(b2VisBody* body);
 };
 
 #endif /* b2VisWorld_hpp */
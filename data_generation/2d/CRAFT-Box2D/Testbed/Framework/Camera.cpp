@@ -7,7 +7,7 @@
 
 #include "Camera.hpp"
 
-Camera g_camera;
+thread_local Camera g_camera;
 
 //
 b2Vec2 Camera::ConvertScreenToWorld(const b2Vec2& ps)
@@ -31,6 +31,7 @@ public:
     int32 m_height;
 };
 
-extern Camera g_camera;
+// One per thread, like g_debugDraw, for simulations of different sizes on the threads of a pool.
+extern thread_local Camera g_camera;
 
 #endif /* Camera_hpp */
@@ -0,0 +1,101 @@
+//
+//  FrameArrayWriter.cpp
+//  Testbed
+//
+
+#include "FrameArrayWriter.hpp"
+#include "FrameSampling.h"
+
+#include <string.h>
+
+// The header is rewritten in place once the frame count is known, so its size is fixed.
+#define NPY_HEADER_LENGTH 128
+
+FrameArrayWriter::FrameArrayWriter()
+{
+    m_pFile = NULL;
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_nFps = 0;
+    m_fSourceFps = 0.0f;
+    m_nFrameCount = 0;
+}
+
+FrameArrayWriter::~FrameArrayWriter()
+{
+    Close();
+}
+
+bool FrameArrayWriter::Open(const std::string& filePath, const int& width, const int& height, const int& fps, const float& sourceFps)
+{
+    m_pFile = fopen(filePath.c_str(), "wb");
+    if (!m_pFile) {
+        fprintf(stderr, "Could not open %s\n", filePath.c_str());
+        return false;
+    }
+
+    m_sPath = filePath;
+    m_nWidth = width;
+    m_nHeight = height;
+    m_nFps = fps;
+    m_fSourceFps = sourceFps;
+    m_nFrameCount = 0;
+
+    return WriteHeader();
+}
+
+// NPY format version 1.0: magic string, version, little endian header length,
+// then a Python dict literal padded with spaces and terminated by a newline.
+bool FrameArrayWriter::WriteHeader()
+{
+    char dict[NPY_HEADER_LENGTH];
+    const int dictLength = snprintf(dict, sizeof(dict),
+        "{'descr': '|u1', 'fortran_order': False, 'shape': (%d, %d, %d, 3), }",
+        m_nFrameCount, m_nHeight, m_nWidth);
+
+    const int prefixLength = 10;
+    const int paddedLength = NPY_HEADER_LENGTH - prefixLength;
+    if (dictLength < 0 || dictLength >= paddedLength) {
+        fprintf(stderr, "Frame array header does not fit for %s\n", m_sPath.c_str());
+        return false;
+    }
+
+    unsigned char header[NPY_HEADER_LENGTH];
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    header[8] = paddedLength & 0xff;
+    header[9] = (paddedLength >> 8) & 0xff;
+    memset(header + prefixLength, ' ', paddedLength);
+    memcpy(header + prefixLength, dict, dictLength);
+    header[NPY_HEADER_LENGTH - 1] = '\n';
+
+    return fwrite(header, 1, NPY_HEADER_LENGTH, m_pFile) == NPY_HEADER_LENGTH;
+}
+
+bool FrameArrayWriter::AcceptsFrame(const int& frameIndex) const
+{
+    return isFrameSampled(frameIndex, m_nFps, m_fSourceFps);
+}
+
+void FrameArrayWriter::Write(const unsigned char* rgb)
+{
+    // Rows are written last to first, which stores the image top-down.
+    const int rowStride = 3 * m_nWidth;
+    for (int row = m_nHeight - 1; row >= 0; --row)
+    {
+        fwrite(rgb + row * rowStride, 1, rowStride, m_pFile);
+    }
+    ++m_nFrameCount;
+}
+
+void FrameArrayWriter::Close()
+{
+    if (!m_pFile)
+        return;
+
+    fseek(m_pFile, 0, SEEK_SET);
+    if (!WriteHeader()) {
+        fprintf(stderr, "Could not finalize %s\n", m_sPath.c_str());
+    }
+    fclose(m_pFile);
+    m_pFile = NULL;
+}
@@ -0,0 +1,43 @@
+//
+//  FrameArrayWriter.hpp
+//  Testbed
+//
+
+#ifndef FrameArrayWriter_hpp
+#define FrameArrayWriter_hpp
+
+#include <stdio.h>
+#include <string>
+
+// Writes frames into a NumPy .npy file holding an (N, H, W, 3) uint8 array, rows top-down,
+// so clips can be opened with np.load(path, mmap_mode="r") without decoding a video.
+// Frames are appended as they arrive and N is filled into the header on Close.
+class FrameArrayWriter
+{
+public:
+    FrameArrayWriter();
+    virtual ~FrameArrayWriter();
+
+    bool Open(const std::string& filePath, const int& width, const int& height, const int& fps, const float& sourceFps);
+
+    // Whether the frameIndex-th rendered frame belongs to the array at its frame rate.
+    bool AcceptsFrame(const int& frameIndex) const;
+
+    // Appends a width * height * 3 frame whose rows are bottom-up as read from OpenGL.
+    void Write(const unsigned char* rgb);
+
+    void Close();
+
+private:
+    bool WriteHeader();
+
+    FILE* m_pFile;
+    std::string m_sPath;
+    int m_nWidth;
+    int m_nHeight;
+    int m_nFps;
+    float m_fSourceFps;
+    int m_nFrameCount;
+};
+
+#endif /* FrameArrayWriter_hpp */
@@ -0,0 +1,23 @@
+//
+//  FrameSampling.h
+//  Testbed
+//
+
+#ifndef FrameSampling_h
+#define FrameSampling_h
+
+#include <math.h>
+
+// Whether the frameIndex-th rendered frame is kept when frames rendered at sourceFps are
+// written at fps. The first frame of every 1 / fps interval is kept, e.g. every 12th frame
+// for 5 fps out of 60.
+inline bool isFrameSampled(const int& frameIndex, const int& fps, const float& sourceFps)
+{
+    if (fps >= sourceFps || frameIndex == 0)
+        return true;
+
+    const double ratio = fps / (double)sourceFps;
+    return floor(frameIndex * ratio) != floor((frameIndex - 1) * ratio);
+}
+
+#endif /* FrameSampling_h */
@@ -0,0 +1,209 @@
+//
+//  ImageWriter.cpp
+//  Testbed
+//
+
+#include "ImageWriter.hpp"
+
+#include <stdio.h>
+#include <png.h>
+
+ImageWriter::ImageWriter()
+{
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_nQueueLength = 0;
+    m_bOpen = false;
+    m_bClosing = false;
+}
+
+ImageWriter::~ImageWriter()
+{
+    Close();
+}
+
+bool ImageWriter::Open(const int& width, const int& height, const ImageWriterOptions& options, const int& queueLength)
+{
+    if (isOpen())
+        Close();
+
+    m_nWidth = width;
+    m_nHeight = height;
+    m_Options = options;
+    m_nQueueLength = queueLength > 0 ? queueLength : 1;
+    m_bOpen = true;
+    m_bClosing = false;
+
+    return true;
+}
+
+void ImageWriter::Write(const std::string& path, const unsigned char* rgb)
+{
+    if (!isOpen())
+    {
+        if (!WritePng(path, rgb, m_nWidth, m_nHeight, m_Options))
+        {
+            fprintf(stderr, "Could not write %s\n", path.c_str());
+        }
+        return;
+    }
+
+    Job job;
+    job.path = path;
+    job.pixels.assign(rgb, rgb + 3 * m_nWidth * m_nHeight);
+    job.isInstanceMask = false;
+    Queue(job);
+}
+
+void ImageWriter::WriteInstanceMask(const std::string& path, const unsigned short* ids)
+{
+    if (!isOpen())
+    {
+        if (!WriteInstanceMaskPng(path, ids, m_nWidth, m_nHeight, m_Options))
+        {
+            fprintf(stderr, "Could not write %s\n", path.c_str());
+        }
+        return;
+    }
+
+    Job job;
+    job.path = path;
+    job.pixels.assign((const unsigned char*)ids, (const unsigned char*)(ids + m_nWidth * m_nHeight));
+    job.isInstanceMask = true;
+    Queue(job);
+}
+
+void ImageWriter::Queue(Job& job)
+{
+    if (!m_WriterThread.joinable())
+        m_WriterThread = std::thread(&ImageWriter::WriterLoop, this);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_QueueChanged.wait(lock, [this] { return m_Jobs.size() < m_nQueueLength; });
+    m_Jobs.push_back(std::move(job));
+    m_QueueChanged.notify_all();
+}
+
+void ImageWriter::WriterLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_QueueChanged.wait(lock, [this] { return m_bClosing || !m_Jobs.empty(); });
+            if (m_Jobs.empty())
+                break;
+
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_QueueChanged.notify_all();
+        }
+
+        const bool written = job.isInstanceMask
+            ? WriteInstanceMaskPng(job.path, (const unsigned short*)job.pixels.data(), m_nWidth, m_nHeight, m_Options)
+            : WritePng(job.path, job.pixels.data(), m_nWidth, m_nHeight, m_Options);
+        if (!written)
+        {
+            fprintf(stderr, "Could not write %s\n", job.path.c_str());
+        }
+    }
+}
+
+void ImageWriter::Close()
+{
+    if (!isOpen())
+        return;
+
+    m_bOpen = false;
+    if (!m_WriterThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bClosing = true;
+    }
+    m_QueueChanged.notify_all();
+    m_WriterThread.join();
+}
+
+bool ImageWriter::isOpen() const
+{
+    return m_bOpen;
+}
+
+static int sGetPngFilters(const std::string& filter)
+{
+    if (filter == "none")
+        return PNG_FILTER_NONE;
+    if (filter == "sub")
+        return PNG_FILTER_SUB;
+    if (filter == "up")
+        return PNG_FILTER_UP;
+    if (filter == "average")
+        return PNG_FILTER_AVG;
+    if (filter == "paeth")
+        return PNG_FILTER_PAETH;
+    return PNG_ALL_FILTERS;
+}
+
+// Writes bottom-up rows of rowSize bytes as a top-down PNG.
+static bool sWritePng(const std::string& path, const unsigned char* data, const int& width, const int& height, const int& bitDepth, const int& colorType, const size_t& rowSize, const ImageWriterOptions& options)
+{
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png)
+        return false;
+
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+
+    std::vector<png_bytep> rows(height);
+    for (int i = 0; i < height; ++i)
+        rows[i] = (png_bytep)(data + (height - i - 1) * rowSize);
+
+    // libpng reports errors by jumping back here.
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png, fp);
+    png_set_IHDR(png, info, width, height, bitDepth, colorType, PNG_INTERLACE_NONE,
+        PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    if (options.compressionLevel >= 0)
+        png_set_compression_level(png, options.compressionLevel);
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, sGetPngFilters(options.filter));
+    png_write_info(png, info);
+
+    // PNG stores 16-bit samples big-endian.
+    const unsigned short one = 1;
+    if (bitDepth == 16 && *(const unsigned char*)&one == 1)
+        png_set_swap(png);
+
+    png_write_image(png, rows.data());
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+
+    fclose(fp);
+    return true;
+}
+
+bool ImageWriter::WritePng(const std::string& path, const unsigned char* rgb, const int& width, const int& height, const ImageWriterOptions& options)
+{
+    return sWritePng(path, rgb, width, height, 8, PNG_COLOR_TYPE_RGB, 3 * width, options);
+}
+
+bool ImageWriter::WriteInstanceMaskPng(const std::string& path, const unsigned short* ids, const int& width, const int& height, const ImageWriterOptions& options)
+{
+    return sWritePng(path, (const unsigned char*)ids, width, height, 16, PNG_COLOR_TYPE_GRAY, 2 * width, options);
+}
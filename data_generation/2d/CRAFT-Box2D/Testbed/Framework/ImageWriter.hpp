@@ -0,0 +1,78 @@
+//
+//  ImageWriter.hpp
+//  Testbed
+//
+
+#ifndef ImageWriter_hpp
+#define ImageWriter_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// PNG encoder settings, filled from the controller JSON.
+struct ImageWriterOptions
+{
+    int compressionLevel = -1;   // zlib level 0-9, -1 for the zlib default. 1 is a good fit for bulk frames.
+    std::string filter = "all";  // Row filter: none, sub, up, average, paeth or all (adaptive).
+};
+
+// Writes PNG files on a background thread so the simulation does not wait on
+// compression and disk I/O. Write copies the frame into a bounded queue and
+// only blocks while the queue is full. The thread is started by the first
+// image queued, simulations that write none never start it.
+class ImageWriter
+{
+public:
+    ImageWriter();
+    virtual ~ImageWriter();
+
+    bool Open(const int& width, const int& height, const ImageWriterOptions& options, const int& queueLength = 16);
+
+    // Queues a width * height * 3 frame whose rows are bottom-up as read from OpenGL.
+    // Writes right away on the calling thread when the writer is not open.
+    void Write(const std::string& path, const unsigned char* rgb);
+
+    // Queues a width * height mask of 16-bit instance ids, bottom-up like Write, written as a
+    // 16-bit grayscale PNG.
+    void WriteInstanceMask(const std::string& path, const unsigned short* ids);
+
+    // Writes the queued images and stops the writer thread.
+    void Close();
+
+    bool isOpen() const;
+
+    // Writes a bottom-up RGB frame as a top-down PNG on the calling thread. The rows are
+    // handed to libpng last to first, the pixels themselves are never flipped.
+    static bool WritePng(const std::string& path, const unsigned char* rgb, const int& width, const int& height, const ImageWriterOptions& options);
+
+    static bool WriteInstanceMaskPng(const std::string& path, const unsigned short* ids, const int& width, const int& height, const ImageWriterOptions& options);
+
+private:
+    struct Job
+    {
+        std::string path;
+        std::vector<unsigned char> pixels;
+        bool isInstanceMask;
+    };
+
+    void Queue(Job& job);
+    void WriterLoop();
+
+    int m_nWidth;
+    int m_nHeight;
+    ImageWriterOptions m_Options;
+    size_t m_nQueueLength;
+
+    std::deque<Job> m_Jobs;
+    std::mutex m_Mutex;
+    std::condition_variable m_QueueChanged;
+    bool m_bOpen;
+    bool m_bClosing;
+    std::thread m_WriterThread;
+};
+
+#endif /* ImageWriter_hpp */
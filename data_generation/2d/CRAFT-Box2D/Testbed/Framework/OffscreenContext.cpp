@@ -0,0 +1,265 @@
+//
+//  OffscreenContext.cpp
+//  Testbed
+//
+
+#include "OffscreenContext.hpp"
+
+#if defined(__APPLE__)
+#define GLFW_INCLUDE_GLCOREARB
+#include <OpenGL/gl3.h>
+#else
+#include "Testbed/glad/glad.h"
+#endif
+
+#if defined(__linux__)
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+static bool sHasExtension(const char* extensions, const char* name)
+{
+    return extensions != NULL && strstr(extensions, name) != NULL;
+}
+
+// Prefers a display backed by a real GPU device, then Mesa's surfaceless
+// platform (llvmpipe on machines without a GPU), then the default display.
+static EGLDisplay sGetDisplay()
+{
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay != NULL && sHasExtension(clientExtensions, "EGL_EXT_platform_device"))
+    {
+        PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+
+        const int maxDevices = 8;
+        EGLDeviceEXT devices[maxDevices];
+        EGLint deviceCount = 0;
+        if (queryDevices != NULL && queryDevices(maxDevices, devices, &deviceCount) && deviceCount > 0)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[0], NULL);
+            if (display != EGL_NO_DISPLAY)
+            {
+                return display;
+            }
+        }
+    }
+
+    if (getPlatformDisplay != NULL && sHasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY)
+        {
+            return display;
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+#endif
+
+OffscreenContext::OffscreenContext()
+{
+    m_pDisplay = NULL;
+    m_pContext = NULL;
+    m_pSurface = NULL;
+
+    m_nFramebufferId = 0;
+    m_nColorRenderbufferId = 0;
+    m_nDepthRenderbufferId = 0;
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    Destroy();
+}
+
+bool OffscreenContext::Create(const int& width, const int& height)
+{
+#if defined(__linux__)
+    EGLDisplay display = sGetDisplay();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || eglInitialize(display, &major, &minor) == EGL_FALSE)
+    {
+        fprintf(stderr, "Could not initialize EGL display.\n");
+        return false;
+    }
+    m_pDisplay = display;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (eglChooseConfig(display, configAttribs, &config, 1, &configCount) == EGL_FALSE || configCount == 0)
+    {
+        fprintf(stderr, "Could not find a suitable EGL config.\n");
+        Destroy();
+        return false;
+    }
+
+    if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE)
+    {
+        fprintf(stderr, "Could not bind OpenGL API to EGL.\n");
+        Destroy();
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        fprintf(stderr, "Could not create EGL context.\n");
+        Destroy();
+        return false;
+    }
+    m_pContext = context;
+
+    // A surface is only needed when the implementation can not make a context current without one.
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!sHasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        if (surface == EGL_NO_SURFACE)
+        {
+            fprintf(stderr, "Could not create EGL pbuffer surface.\n");
+            Destroy();
+            return false;
+        }
+        m_pSurface = surface;
+    }
+
+    if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE)
+    {
+        fprintf(stderr, "Could not make EGL context current.\n");
+        Destroy();
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        fprintf(stderr, "Failed to load OpenGL and its extensions.\n");
+        Destroy();
+        return false;
+    }
+
+    if (!CreateFramebuffer(width, height))
+    {
+        fprintf(stderr, "Could not create offscreen framebuffer.\n");
+        Destroy();
+        return false;
+    }
+
+    return true;
+#else
+    (void)width;
+    (void)height;
+    fprintf(stderr, "Offscreen rendering is only supported on Linux.\n");
+    return false;
+#endif
+}
+
+bool OffscreenContext::CreateFramebuffer(const int& width, const int& height)
+{
+    glGenRenderbuffers(1, &m_nColorRenderbufferId);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_nColorRenderbufferId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &m_nDepthRenderbufferId);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_nDepthRenderbufferId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_nFramebufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_nFramebufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_nColorRenderbufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_nDepthRenderbufferId);
+
+    // Reads and draws both go to the framebuffer object from now on.
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void OffscreenContext::Destroy()
+{
+#if defined(__linux__)
+    if (m_pContext != NULL && eglGetCurrentContext() == (EGLContext)m_pContext)
+    {
+        if (m_nFramebufferId)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &m_nFramebufferId);
+            m_nFramebufferId = 0;
+        }
+
+        if (m_nColorRenderbufferId)
+        {
+            glDeleteRenderbuffers(1, &m_nColorRenderbufferId);
+            m_nColorRenderbufferId = 0;
+        }
+
+        if (m_nDepthRenderbufferId)
+        {
+            glDeleteRenderbuffers(1, &m_nDepthRenderbufferId);
+            m_nDepthRenderbufferId = 0;
+        }
+    }
+
+    if (m_pDisplay != NULL)
+    {
+        EGLDisplay display = (EGLDisplay)m_pDisplay;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+        if (m_pSurface != NULL)
+        {
+            eglDestroySurface(display, (EGLSurface)m_pSurface);
+            m_pSurface = NULL;
+        }
+
+        if (m_pContext != NULL)
+        {
+            eglDestroyContext(display, (EGLContext)m_pContext);
+            m_pContext = NULL;
+        }
+
+        eglTerminate(display);
+        m_pDisplay = NULL;
+    }
+#endif
+}
+
+bool OffscreenContext::isCreated() const
+{
+    return m_pContext != NULL;
+}
+
+unsigned int OffscreenContext::getFramebufferId() const
+{
+    return m_nFramebufferId;
+}
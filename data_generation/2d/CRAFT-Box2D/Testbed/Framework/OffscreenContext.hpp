@@ -0,0 +1,41 @@
+//
+//  OffscreenContext.hpp
+//  Testbed
+//
+
+#ifndef OffscreenContext_hpp
+#define OffscreenContext_hpp
+
+// Creates an OpenGL 3.3 core context without any window system by using EGL
+// (a GPU device when one is exposed, Mesa's surfaceless platform otherwise),
+// and renders into a framebuffer object instead of a window back buffer.
+// SimulationRenderer reads its pixels from whatever framebuffer is bound,
+// so it works on top of this context unchanged.
+class OffscreenContext
+{
+public:
+    OffscreenContext();
+    virtual ~OffscreenContext();
+
+    // Creates the context and a width x height framebuffer, and makes both current.
+    bool Create(const int& width, const int& height);
+
+    void Destroy();
+
+    bool isCreated() const;
+
+    unsigned int getFramebufferId() const;
+
+private:
+    bool CreateFramebuffer(const int& width, const int& height);
+
+    void* m_pDisplay;
+    void* m_pContext;
+    void* m_pSurface;
+
+    unsigned int m_nFramebufferId;
+    unsigned int m_nColorRenderbufferId;
+    unsigned int m_nDepthRenderbufferId;
+};
+
+#endif /* OffscreenContext_hpp */
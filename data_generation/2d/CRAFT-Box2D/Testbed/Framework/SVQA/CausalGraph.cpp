@@ -35,12 +35,53 @@ namespace svqa {
         }
     
         m_EventQueue.push(event);
+        m_Events.push_back(event);
         
         if(eventType == End_Event) {
             constructCausalGraph();
         }
     }
 
+    bool CausalGraph::hasEvents(BODY* object) const
+    {
+        auto objectEvents = m_ObjectEvents.find(object);
+        return objectEvents != m_ObjectEvents.end() && !objectEvents->second.empty();
+    }
+
+    CausalGraph::Ptr CausalGraph::clone(const std::map<BODY*, BODY*>& objects) const
+    {
+        assert(!m_pEndEvent);
+        
+        //Events are added again in the same order, events of the same step keep their order in the queue
+        Ptr graph = create();
+        for(const auto& event : m_Events) {
+            const auto& eventObjects = event->getObjects();
+            BODY* firstObject = eventObjects.size() > 0 ? objects.at(eventObjects[0]) : nullptr;
+            BODY* secondObject = eventObjects.size() > 1 ? objects.at(eventObjects[1]) : nullptr;
+            
+            switch(event->getType()) {
+                case Start_Event:
+                    graph->addEvent(StartEvent::create());
+                    break;
+                case Collision_Event:
+                    graph->addEvent(CollisionEvent::create(event->getStepCount(), firstObject, secondObject));
+                    break;
+                case StartTouching_Event:
+                    graph->addEvent(StartTouchingEvent::create(event->getStepCount(), firstObject, secondObject));
+                    break;
+                case EndTouching_Event:
+                    graph->addEvent(EndTouchingEvent::create(event->getStepCount(), firstObject, secondObject));
+                    break;
+                case ContainerEndUp_Event:
+                    graph->addEvent(ContainerEndUpEvent::create(event->getStepCount(), firstObject, secondObject));
+                    break;
+                default:
+                    break;
+            }
+        }
+        return graph;
+    }
+
     void CausalGraph::constructCausalGraph()
     {
         //Root is the start event
@@ -35,6 +35,12 @@ namespace svqa
             //Gets json object from causal graph
             json toJSON() const;
         
+            //Whether any event of the object has been added
+            bool hasEvents(BODY* object) const;
+        
+            //Copies a graph that has no end event yet with its objects replaced, for simulations resumed from a checkpoint
+            Ptr clone(const std::map<BODY*, BODY*>& objects) const;
+        
             template<typename T> void printEventQueue(T& q) {
                 while(!q.empty()) {
                     std::cout << q.top()->getStepCount() << " " << q.top()->getTypeStr() << std::endl;;
@@ -49,6 +55,7 @@ namespace svqa
             std::map<BODY*, std::vector<CausalEvent::Ptr> >                                                 m_ObjectEvents;     //Map of objects an their events
   
             std::priority_queue<CausalEvent::Ptr, std::vector<CausalEvent::Ptr>, CausalEvent::Order>        m_EventQueue;
+            std::vector<CausalEvent::Ptr>                                                                   m_Events;           //Events in the order they were added
         
             //adds new events to the causal graph returning new root of the graph
             void addEventsToCausalGraph(CausalEvent::Ptr root, CausalEvent::Ptr newEvent);
@@ -61,7 +61,7 @@ typedef Simulation* TestCreateFcn();
 /// Random number in range [-1,1]
 inline float32 RandomFloat()
 {
-	float32 r = (float32)(rand() & (RAND_LIMIT));
+	float32 r = (float32)(Random() & (RAND_LIMIT));
 	r /= RAND_LIMIT;
 	r = 2.0f * r - 1.0f;
 	return r;
@@ -70,7 +70,7 @@ inline float32 RandomFloat()
 /// Random floating point number in range [lo, hi]
 inline float32 RandomFloat(float32 lo, float32 hi)
 {
-	float32 r = (float32)(std::rand() & (RAND_LIMIT));
+	float32 r = (float32)(Random() & (RAND_LIMIT));
 	r /= RAND_LIMIT;
 	r = (hi - lo) * r + lo;
 	return r;
@@ -151,6 +151,8 @@ struct SettingsBase
 		bufferWidth = 640;
 		bufferHeight = 320;
         stepCount = 0;
+		renderFrames = true;
+		renderEveryNSteps = 1;
 	}
 
 	virtual ~SettingsBase()
@@ -180,6 +182,8 @@ struct SettingsBase
 	int bufferWidth;
 	int bufferHeight;
     int stepCount;
+	bool renderFrames; // When false, steps only run physics and need no OpenGL context.
+	int renderEveryNSteps; // Frames are drawn on every n-th step only, physics runs on all of them.
 };
 
 struct TestEntry
@@ -252,6 +256,18 @@ public:
 
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	// Whether the coming Step draws a frame, drivers only begin frames for those steps.
+	bool isRenderedStep(const SettingsBase* settings) const
+	{
+		return settings->renderFrames && m_StepCount % settings->renderEveryNSteps == 0;
+	}
+
+	// The renderer the world draws with, g_debugDraw or a tile of it.
+	SimulationRenderer* getRenderer() const
+	{
+		return m_renderer;
+	}
+
 protected:
 	friend class DestructionListener;
 	friend class BoundaryListener;
@@ -264,6 +280,7 @@ protected:
 	DestructionListener m_destructionListener;
 	int32 m_textLine;
 	WORLD* m_world;
+	SimulationRenderer* m_renderer;
 	b2Body* m_bomb;
 	b2MouseJoint* m_mouseJoint;
 	b2Vec2 m_bombSpawnPoint;
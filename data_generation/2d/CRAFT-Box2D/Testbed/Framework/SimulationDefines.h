@@ -20,4 +20,25 @@
 
 #define COLLISION_DETECTION_STEP_DIFF 20
 
+#include <random>
+
+// Stands in for std::rand and srand with a sequence per thread, so simulations running on
+// different threads neither share nor lock one.
+inline std::minstd_rand& RandomEngine()
+{
+    thread_local std::minstd_rand engine;
+    return engine;
+}
+
+inline void SeedRandom(const unsigned int& seed)
+{
+    RandomEngine().seed(seed);
+}
+
+// A non-negative number, like std::rand.
+inline int Random()
+{
+    return (int)RandomEngine()();
+}
+
 #endif /* SimulationDefines_h */
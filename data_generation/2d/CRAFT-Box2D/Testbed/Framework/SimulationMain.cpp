@@ -28,12 +28,23 @@
 #include "Testbed/imgui/imgui_impl_glfw_gl3.h"
 #include "Camera.hpp"
 #include "Simulation.h"
+#include "OffscreenContext.hpp"
 
 #include "Testbed/glfw/glfw3.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 
 #include "ControllerParser.h"
+#include "VariationRunner.h"
 #include <time.h>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <math.h>
+#include <vector>
 
 #ifdef _MSC_VER
 #define _CRTDBG_MAP_ALLOC
@@ -78,9 +89,7 @@ static void sResizeWindow(GLFWwindow*, int width, int height)
 //
 static void sSimulate(Simulation* simulation, SettingsBase* settings)
 {
-	glEnable(GL_DEPTH_TEST);
 	simulation->Step(settings);
-	glDisable(GL_DEPTH_TEST);
 }
 
 //
@@ -91,13 +100,11 @@ void glfwErrorCallback(int error, const char* description)
 	fprintf(stderr, "GLFW error occured. Code: %d. Description: %s\n", error, description);
 }
 
-void renderLoop(Simulation* simulation, SettingsBase* settings)
+void renderLoop(svqa::SimulationBase* simulation, SettingsBase* settings)
 {
-	while (!glfwWindowShouldClose(mainWindow))
+	while (!glfwWindowShouldClose(mainWindow) && !simulation->isFinished())
 	{
-		glViewport(0, 0, settings->bufferWidth, settings->bufferHeight);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		g_debugDraw.BeginFrame(settings->bufferWidth, settings->bufferHeight);
 
 		ImGui_ImplGlfwGL3_NewFrame();
 		ImGui::SetNextWindowPos(ImVec2(0, 0));
@@ -114,13 +121,467 @@ void renderLoop(Simulation* simulation, SettingsBase* settings)
 	}
 }
 
+// Steps the simulation as fast as possible for dataset generation: no vsync, no buffer swap,
+// no event polling and no UI frame. Frames are still read back from the bound framebuffer.
+void offlineLoop(svqa::SimulationBase* simulation, SettingsBase* settings)
+{
+	const auto start = std::chrono::steady_clock::now();
+	int stepCount = 0;
+
+	while (!simulation->isFinished())
+	{
+		if (simulation->isRenderedStep(settings))
+		{
+			g_debugDraw.BeginFrame(settings->bufferWidth, settings->bufferHeight);
+		}
+
+		sSimulate(simulation, settings);
+		++stepCount;
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	printf("[LOG] %d steps in %.3f s (%.1f steps/sec)\n", stepCount, elapsed.count(),
+		elapsed.count() > 0.0 ? stepCount / elapsed.count() : 0.0);
+}
+
+static int sRunHeadless(svqa::SimulationBase* simulation, svqa::Settings* settings)
+{
+	OffscreenContext context;
+	if (!context.Create(settings->bufferWidth, settings->bufferHeight))
+	{
+		fprintf(stderr, "Failed to create offscreen rendering context\n");
+		return -1;
+	}
+
+	printf("OpenGL %s, GLSL %s\n", glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	g_debugDraw.Create();
+	g_debugDraw.setAntiAliasing(settings->msaaSamples, settings->supersampling);
+
+	glClearColor(1.0f, 1.0f, 1.0f, 1.f);
+	offlineLoop(simulation, settings);
+
+	g_debugDraw.Destroy();
+	context.Destroy();
+
+	return 0;
+}
+
+// Steps several simulations in lockstep and draws each rendered step of all of them into one
+// atlas frame, so a single readback serves every simulation.
+void atlasLoop(const std::vector<svqa::SimulationBase::Ptr>& simulations, const int& width, const int& height)
+{
+	const auto start = std::chrono::steady_clock::now();
+	int stepCount = 0;
+
+	bool finished = false;
+	while (!finished)
+	{
+		bool rendered = false;
+		for (const auto& simulation : simulations)
+		{
+			rendered = rendered || (!simulation->isFinished() && simulation->isRenderedStep(simulation->getSettings().get()));
+		}
+		if (rendered)
+		{
+			g_debugDraw.BeginFrame(width, height);
+		}
+
+		finished = true;
+		for (const auto& simulation : simulations)
+		{
+			if (simulation->isFinished())
+				continue;
+
+			SettingsBase* settings = simulation->getSettings().get();
+			if (simulation->isRenderedStep(settings))
+			{
+				simulation->getRenderer()->BeginFrame(settings->bufferWidth, settings->bufferHeight);
+			}
+
+			sSimulate(simulation.get(), settings);
+			++stepCount;
+			finished = finished && simulation->isFinished();
+		}
+
+		if (rendered)
+		{
+			g_debugDraw.Flush();
+		}
+	}
+	g_debugDraw.Finish();
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	printf("[LOG] %d steps of %d simulations in %.3f s (%.1f steps/sec)\n", stepCount, (int)simulations.size(),
+		elapsed.count(), elapsed.count() > 0.0 ? stepCount / elapsed.count() : 0.0);
+}
+
+// Builds the simulation of a controller JSON, nullptr if the JSON cannot be loaded, is
+// invalid or its settings are not accepted. The settings are checked before the simulation is built
+// since that already creates its output files.
+static svqa::SimulationBase::Ptr sLoadSimulation(const std::string& path, const std::function<bool(const svqa::Settings&)>& accept)
+{
+	try
+	{
+		json controller;
+		if (!JSONHelper::loadJSON(controller, path))
+		{
+			fprintf(stderr, "Could not load simulation %s\n", path.c_str());
+			return nullptr;
+		}
+
+		svqa::Settings settings;
+		settings.from_json(controller);
+		if (!accept(settings))
+			return nullptr;
+
+		svqa::SimulationBase::Ptr simulation = svqa::parse(controller);
+		if (!simulation)
+			fprintf(stderr, "Could not load simulation %s\n", path.c_str());
+		return simulation;
+	}
+	catch (const char* error)
+	{
+		fprintf(stderr, "%s: %s\n", path.c_str(), error);
+	}
+	catch (const std::exception& error)
+	{
+		fprintf(stderr, "%s: %s\n", path.c_str(), error.what());
+	}
+	return nullptr;
+}
+
+// Runs one simulation per controller JSON, tiled into a single offscreen framebuffer. The
+// simulations must render the same way at the same size.
+static int sRunAtlas(char** paths, const int& count)
+{
+	const int columns = (int)ceil(sqrt((double)count));
+	const int rows = (count + columns - 1) / columns;
+	g_debugDraw.setAtlas(columns, rows);
+
+	std::vector<svqa::SimulationBase::Ptr> simulations;
+	for (int i = 0; i < count; ++i)
+	{
+		svqa::SimulationBase::Ptr simulation = sLoadSimulation(paths[i], [&](const svqa::Settings& settings)
+		{
+			const svqa::Settings& first = i == 0 ? settings : *simulations[0]->getSettings();
+			if (settings.renderBackend != "egl"
+				|| settings.bufferWidth != first.bufferWidth
+				|| settings.bufferHeight != first.bufferHeight
+				|| settings.msaaSamples != first.msaaSamples
+				|| settings.supersampling != first.supersampling
+				|| settings.renderEveryNSteps != first.renderEveryNSteps)
+			{
+				fprintf(stderr, "%s: simulations of an atlas need the egl backend and the same size, anti-aliasing and renderEveryNSteps\n", paths[i]);
+				return false;
+			}
+			if (settings.instanceMaskOutputFolder != "" || settings.gpuYuvConversion)
+			{
+				fprintf(stderr, "%s: instance masks and gpuYuvConversion are not available for simulations of an atlas\n", paths[i]);
+				return false;
+			}
+			return true;
+		});
+		if (!simulation)
+			return -1;
+		simulations.push_back(simulation);
+	}
+
+	const auto& first = simulations[0]->getSettings();
+
+	g_camera.m_width = first->bufferWidth;
+	g_camera.m_height = first->bufferHeight;
+
+	OffscreenContext context;
+	if (!context.Create(columns * first->bufferWidth, rows * first->bufferHeight))
+	{
+		fprintf(stderr, "Failed to create offscreen rendering context\n");
+		return -1;
+	}
+
+	printf("OpenGL %s, GLSL %s\n", glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	g_debugDraw.Create();
+	g_debugDraw.setAntiAliasing(first->msaaSamples, first->supersampling);
+
+	glClearColor(1.0f, 1.0f, 1.0f, 1.f);
+	atlasLoop(simulations, columns * first->bufferWidth, rows * first->bufferHeight);
+
+	g_debugDraw.Destroy();
+	context.Destroy();
+
+	return 0;
+}
+
+// Controller JSON paths of a manifest, one per line. Blank lines and lines starting with # are skipped.
+static std::vector<std::string> sReadManifest(const std::string& manifestPath)
+{
+	std::vector<std::string> paths;
+	std::ifstream manifest(manifestPath);
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty() && line[0] != '#')
+			paths.push_back(line);
+	}
+	return paths;
+}
+
+// Runs the controller JSONs of a manifest back to back in this process. The context, shaders
+// and textures are set up once for all of them, so they have to share the backend, size and
+// anti-aliasing of the first one; others are skipped.
+static int sRunBatch(const std::vector<std::string>& paths)
+{
+	svqa::SimulationBase::Ptr simulation = sLoadSimulation(paths[0], [](const svqa::Settings&) { return true; });
+	if (!simulation)
+		return -1;
+	const svqa::Settings::Ptr first = simulation->getSettings();
+
+	g_camera.m_width = first->bufferWidth;
+	g_camera.m_height = first->bufferHeight;
+
+	OffscreenContext context;
+	if (first->renderBackend == "egl")
+	{
+		if (!context.Create(first->bufferWidth, first->bufferHeight))
+		{
+			fprintf(stderr, "Failed to create offscreen rendering context\n");
+			return -1;
+		}
+
+		printf("OpenGL %s, GLSL %s\n", glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+		g_debugDraw.Create();
+		g_debugDraw.setAntiAliasing(first->msaaSamples, first->supersampling);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.f);
+	}
+	else if (first->renderBackend == "software")
+	{
+		SimulationMaterial::setTextureLoadingEnabled(false);
+		g_debugDraw.CreateSoftware();
+	}
+	else if (first->renderBackend == "none")
+	{
+		SimulationMaterial::setTextureLoadingEnabled(false);
+	}
+	else
+	{
+		fprintf(stderr, "Batch runs need the egl, software or none render backend\n");
+		return -1;
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		if (i > 0)
+		{
+			// The previous world gives its meshes back to the renderer before the next one is built.
+			simulation.reset();
+			simulation = sLoadSimulation(paths[i], [&](const svqa::Settings& settings)
+			{
+				if (settings.renderBackend != first->renderBackend
+					|| settings.bufferWidth != first->bufferWidth
+					|| settings.bufferHeight != first->bufferHeight
+					|| settings.msaaSamples != first->msaaSamples
+					|| settings.supersampling != first->supersampling)
+				{
+					fprintf(stderr, "%s: simulations of a batch need the render backend, size and anti-aliasing of the first one\n", paths[i].c_str());
+					return false;
+				}
+				return true;
+			});
+			if (!simulation)
+			{
+				++failed;
+				continue;
+			}
+
+			if (first->renderBackend != "none")
+			{
+				g_debugDraw.Reconfigure();
+			}
+		}
+
+		printf("[LOG] Simulation %d/%d: %s\n", (int)i + 1, (int)paths.size(), paths[i].c_str());
+		try
+		{
+			offlineLoop(simulation.get(), simulation->getSettings().get());
+		}
+		catch (const char* error)
+		{
+			fprintf(stderr, "%s: %s\n", paths[i].c_str(), error);
+			++failed;
+		}
+		catch (const std::exception& error)
+		{
+			fprintf(stderr, "%s: %s\n", paths[i].c_str(), error.what());
+			++failed;
+		}
+	}
+	simulation.reset();
+
+	if (first->renderBackend != "none")
+	{
+		g_debugDraw.Destroy();
+	}
+	if (first->renderBackend == "egl")
+	{
+		context.Destroy();
+	}
+
+	return failed > 0 ? -1 : 0;
+}
+
+// Runs simulations of a manifest on one thread of a pool until none are left. The thread has a
+// renderer, camera and random sequence of its own; each simulation is seeded with seed plus its
+// index in the manifest, whichever thread runs it.
+static void sPoolWorker(const std::vector<std::string>& paths, std::atomic<int>& next, std::atomic<int>& failed, const unsigned int seed)
+{
+	bool rendererCreated = false;
+	for (int i = next++; i < (int)paths.size(); i = next++)
+	{
+		SeedRandom(seed + i);
+		svqa::SimulationBase::Ptr simulation = sLoadSimulation(paths[i], [&](const svqa::Settings& settings)
+		{
+			if (settings.renderBackend != "software" && settings.renderBackend != "none")
+			{
+				fprintf(stderr, "%s: simulations of a pool need the software or none render backend\n", paths[i].c_str());
+				return false;
+			}
+			return true;
+		});
+		if (!simulation)
+		{
+			++failed;
+			continue;
+		}
+
+		const auto& settings = simulation->getSettings();
+		g_camera.m_width = settings->bufferWidth;
+		g_camera.m_height = settings->bufferHeight;
+		if (settings->renderBackend == "software" && !rendererCreated)
+		{
+			g_debugDraw.CreateSoftware();
+			rendererCreated = true;
+		}
+		else if (rendererCreated)
+		{
+			g_debugDraw.Reconfigure();
+		}
+
+		printf("[LOG] Simulation %d/%d: %s\n", i + 1, (int)paths.size(), paths[i].c_str());
+		// An exception escaping this thread would terminate the simulations of all the others.
+		try
+		{
+			offlineLoop(simulation.get(), settings.get());
+		}
+		catch (const char* error)
+		{
+			fprintf(stderr, "%s: %s\n", paths[i].c_str(), error);
+			++failed;
+		}
+		catch (const std::exception& error)
+		{
+			fprintf(stderr, "%s: %s\n", paths[i].c_str(), error.what());
+			++failed;
+		}
+	}
+
+	if (rendererCreated)
+	{
+		g_debugDraw.Destroy();
+	}
+}
+
+// Runs the controller JSONs of a manifest on threadCount threads at once. Without an OpenGL
+// context this is limited to physics only and CPU rendered simulations.
+static int sRunPool(const std::vector<std::string>& paths, const int& threadCount, const unsigned int& seed)
+{
+	SimulationMaterial::setTextureLoadingEnabled(false);
+
+	std::atomic<int> next(0);
+	std::atomic<int> failed(0);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back(sPoolWorker, std::cref(paths), std::ref(next), std::ref(failed), seed);
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	return failed > 0 ? -1 : 0;
+}
+
+// Thread count of an optional trailing "--threads <count>" at args[first], 1 without one and
+// 0 if the trailing arguments are anything else or the count is not a positive number.
+static int sParseThreadCount(const int& c, char** args, const int& first)
+{
+	if (c == first)
+		return 1;
+	if (c != first + 2 || std::string(args[first]) != "--threads")
+		return 0;
+
+	char* end = NULL;
+	const long count = strtol(args[first + 1], &end, 10);
+	if (end == args[first + 1] || *end != '\0' || count < 1 || count > INT_MAX)
+		return 0;
+	return (int)count;
+}
+
 int main(int c, char** args)
 {
 #ifdef _MSC_VER
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_CHECK_ALWAYS_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 	// To produce random numbers rather than getting same numbers on every run.
-	srand(time(NULL) + 42);
+	const unsigned int seed = time(NULL) + 42;
+	SeedRandom(seed);
+
+	// Testbed --batch <manifest> [--threads <count>]
+	if (c > 1 && std::string(args[1]) == "--batch")
+	{
+		const int threadCount = sParseThreadCount(c, args, 3);
+		if (threadCount < 1)
+		{
+			fprintf(stderr, "Usage: %s --batch <manifest> [--threads <count>]\n", args[0]);
+			return -1;
+		}
+
+		const std::vector<std::string> paths = sReadManifest(args[2]);
+		if (paths.empty())
+		{
+			fprintf(stderr, "No controller JSONs in manifest %s\n", args[2]);
+			return -1;
+		}
+
+		if (threadCount > 1)
+		{
+			return sRunPool(paths, threadCount, seed);
+		}
+		return sRunBatch(paths);
+	}
+
+	// Testbed --variations <controller> <variations output> [--threads <count>]
+	if (c > 1 && std::string(args[1]) == "--variations")
+	{
+		const int threadCount = sParseThreadCount(c, args, 4);
+		if (threadCount < 1)
+		{
+			fprintf(stderr, "Usage: %s --variations <controller> <variations output> [--threads <count>]\n", args[0]);
+			return -1;
+		}
+		return svqa::VariationRunner::run(args[2], args[3], threadCount);
+	}
+
+	// More than one controller JSON renders the simulations side by side into an atlas.
+	if (c > 2)
+	{
+		return sRunAtlas(args + 1, c - 1);
+	}
 
 	std::string controllerJSONPath = args[1];
 	const svqa::SimulationBase::Ptr& simulation = svqa::parse(controllerJSONPath);
@@ -132,6 +593,28 @@ int main(int c, char** args)
 	g_camera.m_height = settings->bufferHeight;
 	//g_camera.m_zoom = 1.3f;
 
+	if (settings->renderBackend == "egl")
+	{
+		return sRunHeadless(simulation.get(), settings.get());
+	}
+
+	// Physics only, no OpenGL context is created at all.
+	if (settings->renderBackend == "none")
+	{
+		SimulationMaterial::setTextureLoadingEnabled(false);
+		offlineLoop(simulation.get(), settings.get());
+		return 0;
+	}
+
+	// Frames are rasterised on the CPU, no OpenGL context is created either.
+	if (settings->renderBackend == "software")
+	{
+		SimulationMaterial::setTextureLoadingEnabled(false);
+		g_debugDraw.CreateSoftware();
+		offlineLoop(simulation.get(), settings.get());
+		g_debugDraw.Destroy();
+		return 0;
+	}
 
 	if (glfwInit() == 0)
 	{
@@ -147,7 +630,8 @@ int main(int c, char** args)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-	glfwWindowHint(GLFW_SAMPLES, 16); 
+	// Frames are anti-aliased in the renderer's own render target.
+	glfwWindowHint(GLFW_SAMPLES, 0);
 	if (settings->offline) {
 		// Do not show and focus window.
 		glfwWindowHint(GLFW_FOCUSED, GLFW_FALSE);
@@ -182,17 +666,27 @@ int main(int c, char** args)
 #endif
 
 	g_debugDraw.Create();
+	g_debugDraw.setAntiAliasing(settings->msaaSamples, settings->supersampling);
+
+	glClearColor(1.0f, 1.0f, 1.0f, 1.f);
 
-	sCreateUI(mainWindow);
+	if (settings->offline)
+	{
+		glfwSwapInterval(0);
+		offlineLoop(simulation.get(), settings.get());
+	}
+	else
+	{
+		sCreateUI(mainWindow);
 
-	// Control the frame rate. One draw per monitor refresh.
-	glfwSwapInterval(1);
+		// Control the frame rate. One draw per monitor refresh.
+		glfwSwapInterval(1);
 
-	glClearColor(1.0f, 1.0f, 1.0f, 1.f);
-	renderLoop(simulation.get(), settings.get());
+		renderLoop(simulation.get(), settings.get());
+		ImGui_ImplGlfwGL3_Shutdown();
+	}
 
 	g_debugDraw.Destroy();
-	ImGui_ImplGlfwGL3_Shutdown();
 	glfwTerminate(); 
 
 #ifdef _MSC_VER
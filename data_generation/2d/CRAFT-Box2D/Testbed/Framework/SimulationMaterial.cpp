@@ -9,24 +9,45 @@
 
 const std::string SimulationMaterial::eyesFilePath = "Data/Textures/eyes.png";
 
+b2VisTexture::Ptr SimulationMaterial::materialTextures;
 b2VisTexture::Ptr SimulationMaterial::eyesTexture;
 b2VisTexture::Ptr SimulationMaterial::platformTexture;
 b2VisTexture::Ptr SimulationMaterial::sensorTexture;
 
-b2VisTexture::Ptr SimulationMaterial::getTexture()
+std::once_flag SimulationMaterial::texturesCreated;
+std::atomic<bool> SimulationMaterial::textureLoadingEnabled(true);
+
+void SimulationMaterial::setTextureLoadingEnabled(const bool& enabled)
 {
-    if (!SimulationMaterial::platformTexture) {
-        SimulationMaterial::platformTexture = b2VisTexture::Ptr(new b2VisTexture( SimulationMaterial::TYPE::PLATFORM));
-    }
-    
-    if (!SimulationMaterial::sensorTexture) {
-        SimulationMaterial::sensorTexture = b2VisTexture::Ptr(new b2VisTexture( SimulationMaterial::TYPE::SENSOR));
+    SimulationMaterial::textureLoadingEnabled = enabled;
+}
+
+std::vector<std::string> SimulationMaterial::getImageFilePaths()
+{
+    // Platform and sensor have no image and are drawn in the body colour
+    return { SimulationMaterial::eyesFilePath, "", "" };
+}
+
+void SimulationMaterial::createTextures()
+{
+    if (SimulationMaterial::textureLoadingEnabled) {
+        SimulationMaterial::materialTextures = b2VisTexture::Ptr(new b2VisTexture(getImageFilePaths()));
+        SimulationMaterial::eyesTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::materialTextures, SimulationMaterial::TYPE::EYES));
+        SimulationMaterial::platformTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::materialTextures, SimulationMaterial::TYPE::PLATFORM));
+        SimulationMaterial::sensorTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::materialTextures, SimulationMaterial::TYPE::SENSOR));
     }
-    
-    if (!SimulationMaterial::eyesTexture) {
-        SimulationMaterial::eyesTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::eyesFilePath, SimulationMaterial::TYPE::EYES));
+    else {
+        SimulationMaterial::eyesTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::TYPE::EYES));
+        SimulationMaterial::platformTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::TYPE::PLATFORM));
+        SimulationMaterial::sensorTexture = b2VisTexture::Ptr(new b2VisTexture(SimulationMaterial::TYPE::SENSOR));
     }
-    
+}
+
+b2VisTexture::Ptr SimulationMaterial::getTexture()
+{
+    // Pool threads reach this at once, the textures are only read after they are created.
+    std::call_once(SimulationMaterial::texturesCreated, &SimulationMaterial::createTextures);
+
     if (type == EYES) {
         return SimulationMaterial::eyesTexture;
     }
@@ -8,7 +8,10 @@
 #ifndef SimulationMaterial_h
 #define SimulationMaterial_h
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "Box2D/Extension/b2VisTexture.hpp"
 #include <nlohmann/json.hpp>
 
@@ -37,14 +40,28 @@ public:
     //Creates the texture associated with the material
     b2VisTexture::Ptr getTexture();
 
+    //Image files are not loaded into OpenGL when disabled, for runs without a context. Only has an
+    //effect before the first getTexture, the textures are created once for every thread
+    static void setTextureLoadingEnabled(const bool& enabled);
+
+    //Image file of every material, indexed by TYPE, empty for materials drawn in the body colour
+    static std::vector<std::string> getImageFilePaths();
+
 private:
+    static void createTextures();
+
     static const std::string eyesFilePath;
     static const std::string platformFilePath;
     static const std::string sensorFilePath;
 
+    // One texture array holding every material, indexed by TYPE, so a frame needs no texture rebinds
+    static b2VisTexture::Ptr materialTextures;
     static b2VisTexture::Ptr eyesTexture;
     static b2VisTexture::Ptr platformTexture;
     static b2VisTexture::Ptr sensorTexture;
+
+    static std::once_flag texturesCreated;
+    static std::atomic<bool> textureLoadingEnabled;
 };
 
 NLOHMANN_JSON_SERIALIZE_ENUM(SimulationMaterial::TYPE, {
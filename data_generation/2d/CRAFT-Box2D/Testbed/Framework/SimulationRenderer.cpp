@@ -18,12 +18,14 @@
 #include "Testbed/glfw/glfw3.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <vector>
-#include <png.h>
 
-extern "C" {
-#include "VideoWriter.h"
-}
+#include "VideoWriter.hpp"
+#include "FrameArrayWriter.hpp"
+#include "ImageWriter.hpp"
+#include "SoftwareRenderer.hpp"
+#include "SimulationMaterial.h"
 
 #include "Testbed/imgui/imgui.h"
 #include <iostream>
@@ -35,7 +37,7 @@ extern "C" {
 
 #define TEXTURE_SQUARE_EDGE_LENGTH 7.5
 
-SimulationRenderer g_debugDraw;
+thread_local SimulationRenderer g_debugDraw;
 
 //
 static void sCheckGLError()
@@ -105,6 +107,7 @@ static GLuint sCreateShaderProgram(const char* vs, const char* fs)
     glAttachShader(programId, vsId);
     glAttachShader(programId, fsId);
     glBindFragDataLocation(programId, 0, "color");
+    glBindFragDataLocation(programId, 1, "instanceId");
     glLinkProgram(programId);
 
     glDeleteShader(vsId);
@@ -128,10 +131,13 @@ struct GLRenderPoints
         "layout(location = 0) in vec2 v_position;\n"
         "layout(location = 1) in vec4 v_color;\n"
         "layout(location = 2) in float v_size;\n"
+        "layout(location = 3) in uint v_instanceId;\n"
         "out vec4 f_color;\n"
+        "flat out uint f_instanceId;\n"
         "void main(void)\n"
         "{\n"
         "    f_color = v_color;\n"
+        "    f_instanceId = v_instanceId;\n"
         "    gl_Position = projectionMatrix * vec4(v_position, 0.0f, 1.0f);\n"
         "   gl_PointSize = v_size;\n"
         "}\n";
@@ -139,10 +145,13 @@ struct GLRenderPoints
         const char* fs = \
         "#version 330\n"
         "in vec4 f_color;\n"
+        "flat in uint f_instanceId;\n"
         "out vec4 color;\n"
+        "out uint instanceId;\n"
         "void main(void)\n"
         "{\n"
         "    color = f_color;\n"
+        "    instanceId = f_instanceId;\n"
         "}\n";
         
         m_programId = sCreateShaderProgram(vs, fs);
@@ -150,15 +159,17 @@ struct GLRenderPoints
         m_vertexAttribute = 0;
         m_colorAttribute = 1;
         m_sizeAttribute = 2;
+        m_instanceIdAttribute = 3;
         
         // Generate
         glGenVertexArrays(1, &m_vaoId);
-        glGenBuffers(3, m_vboIds);
+        glGenBuffers(4, m_vboIds);
         
         glBindVertexArray(m_vaoId);
         glEnableVertexAttribArray(m_vertexAttribute);
         glEnableVertexAttribArray(m_colorAttribute);
         glEnableVertexAttribArray(m_sizeAttribute);
+        glEnableVertexAttribArray(m_instanceIdAttribute);
         
         // Vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
@@ -173,6 +184,10 @@ struct GLRenderPoints
         glVertexAttribPointer(m_sizeAttribute, 1, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
         glBufferData(GL_ARRAY_BUFFER, sizeof(m_sizes), m_sizes, GL_DYNAMIC_DRAW);
 
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[3]);
+        glVertexAttribIPointer(m_instanceIdAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+        glBufferData(GL_ARRAY_BUFFER, sizeof(m_instanceIds), m_instanceIds, GL_DYNAMIC_DRAW);
+
         sCheckGLError();
         
         // Cleanup
@@ -180,6 +195,7 @@ struct GLRenderPoints
         glBindVertexArray(0);
         
         m_count = 0;
+        m_instanceId = 0;
     }
     
     void Destroy()
@@ -187,7 +203,7 @@ struct GLRenderPoints
         if (m_vaoId)
         {
             glDeleteVertexArrays(1, &m_vaoId);
-            glDeleteBuffers(2, m_vboIds);
+            glDeleteBuffers(4, m_vboIds);
             m_vaoId = 0;
         }
         
@@ -206,6 +222,7 @@ struct GLRenderPoints
         m_vertices[m_count] = v;
         m_colors[m_count] = c;
         m_sizes[m_count] = size;
+        m_instanceIds[m_count] = m_instanceId;
         ++m_count;
     }
     
@@ -231,6 +248,9 @@ struct GLRenderPoints
         
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[2]);
         glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(float32), m_sizes);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[3]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(uint32), m_instanceIds);
 
         glEnable(GL_PROGRAM_POINT_SIZE);
         glDrawArrays(GL_POINTS, 0, m_count);
@@ -249,16 +269,19 @@ struct GLRenderPoints
     b2Vec2 m_vertices[e_maxVertices];
     b2Color m_colors[e_maxVertices];
     float32 m_sizes[e_maxVertices];
+    uint32 m_instanceIds[e_maxVertices];
 
     int32 m_count;
+    uint32 m_instanceId; // of the following vertices
     
     GLuint m_vaoId;
-    GLuint m_vboIds[3];
+    GLuint m_vboIds[4];
     GLuint m_programId;
     GLint m_projectionUniform;
     GLint m_vertexAttribute;
     GLint m_colorAttribute;
     GLint m_sizeAttribute;
+    GLint m_instanceIdAttribute;
 };
 
 //
@@ -271,34 +294,42 @@ struct GLRenderLines
         "uniform mat4 projectionMatrix;\n"
         "layout(location = 0) in vec2 v_position;\n"
         "layout(location = 1) in vec4 v_color;\n"
+        "layout(location = 2) in uint v_instanceId;\n"
         "out vec4 f_color;\n"
+        "flat out uint f_instanceId;\n"
         "void main(void)\n"
         "{\n"
         "    f_color = v_color;\n"
+        "    f_instanceId = v_instanceId;\n"
         "    gl_Position = projectionMatrix * vec4(v_position, 0.0f, 1.0f);\n"
         "}\n";
         
         const char* fs = \
         "#version 330\n"
         "in vec4 f_color;\n"
+        "flat in uint f_instanceId;\n"
         "out vec4 color;\n"
+        "out uint instanceId;\n"
         "void main(void)\n"
         "{\n"
         "    color = f_color;\n"
+        "    instanceId = f_instanceId;\n"
         "}\n";
         
         m_programId = sCreateShaderProgram(vs, fs);
         m_projectionUniform = glGetUniformLocation(m_programId, "projectionMatrix");
         m_vertexAttribute = 0;
         m_colorAttribute = 1;
+        m_instanceIdAttribute = 2;
         
         // Generate
         glGenVertexArrays(1, &m_vaoId);
-        glGenBuffers(2, m_vboIds);
+        glGenBuffers(3, m_vboIds);
         
         glBindVertexArray(m_vaoId);
         glEnableVertexAttribArray(m_vertexAttribute);
         glEnableVertexAttribArray(m_colorAttribute);
+        glEnableVertexAttribArray(m_instanceIdAttribute);
         
         // Vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
@@ -309,6 +340,10 @@ struct GLRenderLines
         glVertexAttribPointer(m_colorAttribute, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
         glBufferData(GL_ARRAY_BUFFER, sizeof(m_colors), m_colors, GL_DYNAMIC_DRAW);
         
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[2]);
+        glVertexAttribIPointer(m_instanceIdAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+        glBufferData(GL_ARRAY_BUFFER, sizeof(m_instanceIds), m_instanceIds, GL_DYNAMIC_DRAW);
+
         sCheckGLError();
         
         // Cleanup
@@ -316,6 +351,7 @@ struct GLRenderLines
         glBindVertexArray(0);
         
         m_count = 0;
+        m_instanceId = 0;
     }
     
     void Destroy()
@@ -323,7 +359,7 @@ struct GLRenderLines
         if (m_vaoId)
         {
             glDeleteVertexArrays(1, &m_vaoId);
-            glDeleteBuffers(2, m_vboIds);
+            glDeleteBuffers(3, m_vboIds);
             m_vaoId = 0;
         }
         
@@ -341,6 +377,7 @@ struct GLRenderLines
         
         m_vertices[m_count] = v;
         m_colors[m_count] = c;
+        m_instanceIds[m_count] = m_instanceId;
         ++m_count;
     }
     
@@ -364,6 +401,9 @@ struct GLRenderLines
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[1]);
         glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(b2Color), m_colors);
         
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[2]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(uint32), m_instanceIds);
+        
         glDrawArrays(GL_LINES, 0, m_count);
         
         sCheckGLError();
@@ -378,18 +418,41 @@ struct GLRenderLines
     enum { e_maxVertices = 2 * 512 };
     b2Vec2 m_vertices[e_maxVertices];
     b2Color m_colors[e_maxVertices];
+    uint32 m_instanceIds[e_maxVertices];
     
     int32 m_count;
+    uint32 m_instanceId; // of the following vertices
     
     GLuint m_vaoId;
-    GLuint m_vboIds[2];
+    GLuint m_vboIds[3];
     GLuint m_programId;
     GLint m_projectionUniform;
     GLint m_vertexAttribute;
     GLint m_colorAttribute;
+    GLint m_instanceIdAttribute;
 };
 
 #if RENDER_TEXTURES
+// Samples layer f_matIndex of the material texture array. Chroma key green texels,
+// and materials without an image, are drawn in the body colour. The instance id goes
+// into the second colour attachment when the frame has one.
+static const char* sMaterialFragmentShader = \
+    "#version 330\n"
+    "in vec4 f_color;\n"
+    "in vec2 f_texCoord;\n"
+    "flat in int f_matIndex;\n"
+    "flat in uint f_instanceId;\n"
+    "out vec4 color;\n"
+    "out uint instanceId;\n"
+    "uniform sampler2DArray materialTextures;\n"
+    "void main(void)\n"
+    "{\n"
+    "    vec4 texCol = texture(materialTextures, vec3(f_texCoord, float(f_matIndex)));\n"
+    "    if ((texCol.r <= 0.05 && texCol.g >= 0.95 && texCol.b <= 0.05)) { color = f_color; } \n"
+    "    else { color = texCol; } \n"
+    "    instanceId = f_instanceId;\n"
+    "}\n";
+
 struct GLRenderTriangles
 {
     void Create()
@@ -401,56 +464,41 @@ struct GLRenderTriangles
             "layout(location = 1) in vec4 v_color;\n"
             "layout(location = 2) in vec2 v_texCoord;\n"
             "layout(location = 3) in int v_matIndex;\n"
+            "layout(location = 4) in uint v_instanceId;\n"
             "out vec4 f_color;\n"
+            "flat out uint f_instanceId;\n"
             "out vec2 f_texCoord;\n"
             "flat out int f_matIndex;\n"
             "void main(void)\n"
             "{\n"
             "    f_color = v_color;\n"
+            "    f_instanceId = v_instanceId;\n"
             "    f_texCoord = v_texCoord;\n"
             "    f_matIndex = v_matIndex;\n"
             "    gl_Position = projectionMatrix * vec4(v_position, 0.0f, 1.0f);\n"
             "}\n";
         
-        const char* fs = \
-            "#version 330\n"
-            "in vec4 f_color;\n"
-            "in vec2 f_texCoord;\n"
-            "flat in int f_matIndex;\n"
-            "out vec4 color;\n"
-            "uniform sampler2D eyesTexture;\n" 
-            "void main(void)\n"
-            "{\n"
-            //"    if (f_matIndex==1) { color = vec4(0.0, 0.0, 0.0, 1.0); }" // If platform
-            //"    else if (f_matIndex==2) { color = vec4(0.9, 0.9, 0.9, 1.0); } \n" // If Sensor body
-            //"    else { \n"
-            "        vec4 texCol = (f_matIndex==0) ? texture(eyesTexture, f_texCoord) : vec4(0.0,1.0,0.0,1.0);\n"
-            "        if ((texCol.r <= 0.05 && texCol.g >= 0.95 && texCol.b <= 0.05)) { color = f_color; } \n"
-            "        else { color = texCol; } \n"
-            //"    } \n"
-            "   "
-            "}\n";
-        
-        m_textureUniforms = std::vector<GLint>(3, -1);
-        m_textureIds = std::vector<GLint>(3, -1);
+        m_textureId = 0;
 
-        m_programId = sCreateShaderProgram(vs, fs);
+        m_programId = sCreateShaderProgram(vs, sMaterialFragmentShader);
         m_projectionUniform = glGetUniformLocation(m_programId, "projectionMatrix");
-        m_textureUniforms[0] = (glGetUniformLocation(m_programId, "eyesTexture"));
+        m_textureUniform = glGetUniformLocation(m_programId, "materialTextures");
         m_vertexAttribute = 0;
         m_colorAttribute = 1;
         m_TextureCoordAttribute = 2;
         m_MaterialIndexAttribute = 3;
+        m_instanceIdAttribute = 4;
 
         // Generate
         glGenVertexArrays(1, &m_vaoId);
-        glGenBuffers(4, m_vboIds);
+        glGenBuffers(5, m_vboIds);
 
         glBindVertexArray(m_vaoId);
         glEnableVertexAttribArray(m_vertexAttribute);
         glEnableVertexAttribArray(m_colorAttribute);
         glEnableVertexAttribArray(m_TextureCoordAttribute);
         glEnableVertexAttribArray(m_MaterialIndexAttribute);
+        glEnableVertexAttribArray(m_instanceIdAttribute);
 
         // Vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
@@ -466,9 +514,13 @@ struct GLRenderTriangles
         glBufferData(GL_ARRAY_BUFFER, sizeof(m_texCoordinates), m_texCoordinates, GL_DYNAMIC_DRAW);
         
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[3]);
-        glVertexAttribPointer(m_MaterialIndexAttribute, 1, GL_INT, GL_FALSE, 0, BUFFER_OFFSET(0));
+        glVertexAttribIPointer(m_MaterialIndexAttribute, 1, GL_INT, 0, BUFFER_OFFSET(0));
         glBufferData(GL_ARRAY_BUFFER, sizeof(m_materials), m_materials, GL_DYNAMIC_DRAW);
 
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[4]);
+        glVertexAttribIPointer(m_instanceIdAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+        glBufferData(GL_ARRAY_BUFFER, sizeof(m_instanceIds), m_instanceIds, GL_DYNAMIC_DRAW);
+
         sCheckGLError();
 
         // Cleanup
@@ -476,6 +528,7 @@ struct GLRenderTriangles
         glBindVertexArray(0);
 
         m_count = 0;
+        m_instanceId = 0;
     }
 
     void Destroy()
@@ -483,7 +536,7 @@ struct GLRenderTriangles
         if (m_vaoId)
         {
             glDeleteVertexArrays(1, &m_vaoId);
-            glDeleteBuffers(4, m_vboIds);
+            glDeleteBuffers(5, m_vboIds);
             m_vaoId = 0;
         }
 
@@ -503,6 +556,7 @@ struct GLRenderTriangles
         m_colors[m_count] = c;
         m_texCoordinates[m_count] = t;
         m_materials[m_count] = m;
+        m_instanceIds[m_count] = m_instanceId;
         ++m_count;
     }
 
@@ -532,23 +586,14 @@ struct GLRenderTriangles
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[3]);
         glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(int), m_materials);
         
-        if(m_textureIds[0]>0) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[4]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(uint32), m_instanceIds);
+        
+        if(m_textureId>0) {
             glActiveTexture(GL_TEXTURE0); // activate the texture unit first before binding texture
-            glBindTexture(GL_TEXTURE_2D, m_textureIds[0]);
-            glUniform1i(m_textureUniforms[0], 0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureId);
+            glUniform1i(m_textureUniform, 0);
         }
-
-        //if (m_textureIds[1] > 0) {
-        //    glActiveTexture(GL_TEXTURE1); // activate the texture unit first before binding texture
-        //    glBindTexture(GL_TEXTURE_2D, m_textureIds[1]);
-        //    glUniform1i(m_textureUniforms[1], 1);
-        //}
-        //
-        //if (m_textureIds[2] > 0) {
-        //    glActiveTexture(GL_TEXTURE2); // activate the texture unit first before binding texture
-        //    glBindTexture(GL_TEXTURE_2D, m_textureIds[2]);
-        //    glUniform1i(m_textureUniforms[2], 2);
-        //}
         
         glEnable(GL_BLEND);
         glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -569,19 +614,312 @@ struct GLRenderTriangles
     b2Color m_colors[e_maxVertices];
     b2Vec2 m_texCoordinates[e_maxVertices];
     int m_materials[e_maxVertices];
+    uint32 m_instanceIds[e_maxVertices];
 
     int32 m_count;
+    uint32 m_instanceId; // of the following vertices
 
     GLuint m_vaoId;
-    GLuint m_vboIds[4];
+    GLuint m_vboIds[5];
     GLuint m_programId;
     GLint m_projectionUniform;
-    std::vector<GLint> m_textureUniforms;
+    GLint m_textureUniform;
     GLint m_vertexAttribute;
     GLint m_colorAttribute;
     GLint m_TextureCoordAttribute;
     GLint m_MaterialIndexAttribute;
-    std::vector<GLint> m_textureIds;
+    GLint m_instanceIdAttribute;
+    GLuint m_textureId;
+};
+
+// Body meshes live in one static vertex buffer in body space. Every frame only an instance
+// per drawn body (transform, colour, material, mesh range) is uploaded, and all of them are
+// drawn with a single instanced call. The vertex shader fetches the vertices of its instance's
+// mesh from the buffer and drops the ones past the end of a shorter mesh. Instances are
+// rasterised in order, so the draw order of the bodies is kept.
+struct GLRenderMeshes
+{
+    struct MeshVertex
+    {
+        b2Vec2 position;
+        b2Vec2 texCoord;
+    };
+    
+    struct Mesh
+    {
+        int32 first;
+        int32 count;
+        bool worldTexCoords;
+        int32 references;
+    };
+    
+    struct MeshInstance
+    {
+        float32 transform[4]; // translation, cosine and sine of the rotation
+        b2Color color;
+        int matIndex;
+        int worldTexCoords;
+        int32 mesh[2]; // first vertex and vertex count
+        uint32 instanceId;
+    };
+    
+    void Create()
+    {
+        const char* vs = \
+            "#version 330\n"
+            "uniform mat4 projectionMatrix;\n"
+            "uniform float textureEdgeLength;\n"
+            "uniform samplerBuffer meshVertices;\n"
+            "layout(location = 0) in vec4 i_transform;\n"
+            "layout(location = 1) in vec4 i_color;\n"
+            "layout(location = 2) in int i_matIndex;\n"
+            "layout(location = 3) in int i_worldTexCoords;\n"
+            "layout(location = 4) in ivec2 i_mesh;\n"
+            "layout(location = 5) in uint i_instanceId;\n"
+            "out vec4 f_color;\n"
+            "out vec2 f_texCoord;\n"
+            "flat out int f_matIndex;\n"
+            "flat out uint f_instanceId;\n"
+            "void main(void)\n"
+            "{\n"
+            "    if (gl_VertexID >= i_mesh.y) {\n"
+            "        f_color = vec4(0.0);\n"
+            "        f_texCoord = vec2(0.0);\n"
+            "        f_matIndex = 0;\n"
+            "        f_instanceId = 0u;\n"
+            "        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);\n" // Whole triangles outside the clip volume
+            "        return;\n"
+            "    }\n"
+            "    vec4 vertex = texelFetch(meshVertices, i_mesh.x + gl_VertexID);\n"
+            "    vec2 v_position = vertex.xy;\n"
+            "    vec2 v_texCoord = vertex.zw;\n"
+            "    vec2 position = vec2(i_transform.z * v_position.x - i_transform.w * v_position.y,\n"
+            "                         i_transform.w * v_position.x + i_transform.z * v_position.y) + i_transform.xy;\n"
+            "    f_color = i_color;\n"
+            "    f_texCoord = (i_worldTexCoords != 0) ? position / textureEdgeLength : v_texCoord;\n"
+            "    f_matIndex = i_matIndex;\n"
+            "    f_instanceId = i_instanceId;\n"
+            "    gl_Position = projectionMatrix * vec4(position, 0.0f, 1.0f);\n"
+            "}\n";
+        
+        m_textureId = 0;
+        
+        m_programId = sCreateShaderProgram(vs, sMaterialFragmentShader);
+        m_projectionUniform = glGetUniformLocation(m_programId, "projectionMatrix");
+        m_textureEdgeLengthUniform = glGetUniformLocation(m_programId, "textureEdgeLength");
+        m_textureUniform = glGetUniformLocation(m_programId, "materialTextures");
+        m_meshVerticesUniform = glGetUniformLocation(m_programId, "meshVertices");
+        
+        // Generate
+        glGenVertexArrays(1, &m_vaoId);
+        glGenBuffers(2, m_vboIds);
+        
+        glBindVertexArray(m_vaoId);
+        
+        // Mesh buffer, read by the vertex shader as a buffer texture of (position, texCoord)
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
+        glGenTextures(1, &m_verticesTextureId);
+        glBindTexture(GL_TEXTURE_BUFFER, m_verticesTextureId);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_vboIds[0]);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        
+        // Instance buffer
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[1]);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, transform)));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, color)));
+        glVertexAttribIPointer(2, 1, GL_INT, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, matIndex)));
+        glVertexAttribIPointer(3, 1, GL_INT, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, worldTexCoords)));
+        glVertexAttribIPointer(4, 2, GL_INT, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, mesh)));
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(MeshInstance), BUFFER_OFFSET(offsetof(MeshInstance, instanceId)));
+        for (GLuint attribute = 0; attribute < 6; ++attribute)
+        {
+            glEnableVertexAttribArray(attribute);
+            glVertexAttribDivisor(attribute, 1);
+        }
+        
+        sCheckGLError();
+        
+        // Cleanup
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        
+        m_nMaxMeshCount = 0;
+        m_bVerticesChanged = false;
+        m_instanceId = 0;
+    }
+    
+    void Destroy()
+    {
+        if (m_vaoId)
+        {
+            glDeleteVertexArrays(1, &m_vaoId);
+            glDeleteBuffers(2, m_vboIds);
+            glDeleteTextures(1, &m_verticesTextureId);
+            m_vaoId = 0;
+        }
+        
+        if (m_programId)
+        {
+            glDeleteProgram(m_programId);
+            m_programId = 0;
+        }
+        
+        m_meshes.clear();
+        m_vertices.clear();
+        m_instances.clear();
+        m_nMaxMeshCount = 0;
+    }
+    
+    // Identical meshes, e.g. every small cube, are shared so that their instances can be batched.
+    uint32 CreateMesh(const b2Vec2* vertices, const b2Vec2* texCoords, int32 count, bool worldTexCoords)
+    {
+        for (size_t i = 0; i < m_meshes.size(); ++i)
+        {
+            Mesh& mesh = m_meshes[i];
+            if (mesh.count != count || mesh.worldTexCoords != worldTexCoords)
+                continue;
+            
+            int32 j = 0;
+            while (j < count
+                   && m_vertices[mesh.first + j].position == vertices[j]
+                   && m_vertices[mesh.first + j].texCoord == texCoords[j])
+            {
+                ++j;
+            }
+            
+            if (j == count)
+            {
+                ++mesh.references;
+                return uint32(i + 1);
+            }
+        }
+        
+        Mesh mesh;
+        mesh.first = (int32)m_vertices.size();
+        mesh.count = count;
+        mesh.worldTexCoords = worldTexCoords;
+        mesh.references = 1;
+        m_meshes.push_back(mesh);
+        
+        for (int32 i = 0; i < count; ++i)
+        {
+            MeshVertex vertex;
+            vertex.position = vertices[i];
+            vertex.texCoord = texCoords[i];
+            m_vertices.push_back(vertex);
+        }
+        m_bVerticesChanged = true;
+        
+        return uint32(m_meshes.size());
+    }
+    
+    // The storage is only reclaimed once no mesh is referenced, e.g. when a world is destroyed.
+    void DestroyMesh(uint32 meshId)
+    {
+        if (meshId == 0 || meshId > m_meshes.size() || m_meshes[meshId - 1].references == 0)
+            return;
+        
+        --m_meshes[meshId - 1].references;
+        
+        for (const Mesh& mesh : m_meshes)
+        {
+            if (mesh.references > 0)
+                return;
+        }
+        
+        Flush();
+        m_meshes.clear();
+        m_vertices.clear();
+        m_bVerticesChanged = true;
+    }
+    
+    void Instance(uint32 meshId, const b2Transform& xf, const b2Color& c, const int& m)
+    {
+        MeshInstance instance;
+        instance.transform[0] = xf.p.x;
+        instance.transform[1] = xf.p.y;
+        instance.transform[2] = xf.q.c;
+        instance.transform[3] = xf.q.s;
+        instance.color = c;
+        instance.matIndex = m;
+        const Mesh& mesh = m_meshes[meshId - 1];
+        instance.worldTexCoords = mesh.worldTexCoords ? 1 : 0;
+        instance.mesh[0] = mesh.first;
+        instance.mesh[1] = mesh.count;
+        instance.instanceId = m_instanceId;
+        m_instances.push_back(instance);
+        m_nMaxMeshCount = b2Max(m_nMaxMeshCount, mesh.count);
+    }
+    
+    void Flush()
+    {
+        if (m_instances.empty())
+            return;
+        
+        glUseProgram(m_programId);
+        
+        float32 proj[16] = { 0.0f };
+        g_camera.BuildProjectionMatrix(proj, 0.2f);
+        
+        glUniformMatrix4fv(m_projectionUniform, 1, GL_FALSE, proj);
+        glUniform1f(m_textureEdgeLengthUniform, TEXTURE_SQUARE_EDGE_LENGTH);
+        
+        glBindVertexArray(m_vaoId);
+        
+        if (m_bVerticesChanged)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
+            glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(MeshVertex), m_vertices.data(), GL_STATIC_DRAW);
+            m_bVerticesChanged = false;
+        }
+        
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[1]);
+        glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(MeshInstance), m_instances.data(), GL_STREAM_DRAW);
+        
+        if(m_textureId>0) {
+            glActiveTexture(GL_TEXTURE0); // activate the texture unit first before binding texture
+            glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureId);
+            glUniform1i(m_textureUniform, 0);
+        }
+        
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, m_verticesTextureId);
+        glUniform1i(m_meshVerticesUniform, 1);
+        
+        glEnable(GL_BLEND);
+        glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_nMaxMeshCount, GLsizei(m_instances.size()));
+        glDisable(GL_BLEND);
+        
+        sCheckGLError();
+        
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        
+        m_instances.clear();
+        m_nMaxMeshCount = 0;
+    }
+    
+    std::vector<Mesh> m_meshes;
+    std::vector<MeshVertex> m_vertices;
+    bool m_bVerticesChanged;
+    
+    std::vector<MeshInstance> m_instances;
+    int32 m_nMaxMeshCount;
+    uint32 m_instanceId; // of the following instances
+    
+    GLuint m_vaoId;
+    GLuint m_vboIds[2];
+    GLuint m_verticesTextureId;
+    GLuint m_programId;
+    GLint m_projectionUniform;
+    GLint m_textureEdgeLengthUniform;
+    GLint m_textureUniform;
+    GLint m_meshVerticesUniform;
+    GLuint m_textureId;
 };
 #else
 struct GLRenderTriangles
@@ -593,34 +931,42 @@ struct GLRenderTriangles
             "uniform mat4 projectionMatrix;\n"
             "layout(location = 0) in vec2 v_position;\n"
             "layout(location = 1) in vec4 v_color;\n"
+            "layout(location = 2) in uint v_instanceId;\n"
             "out vec4 f_color;\n"
+            "flat out uint f_instanceId;\n"
             "void main(void)\n"
             "{\n"
             "    f_color = v_color;\n"
+            "    f_instanceId = v_instanceId;\n"
             "    gl_Position = projectionMatrix * vec4(v_position, 0.0f, 1.0f);\n"
             "}\n";
 
         const char* fs = \
             "#version 330\n"
             "in vec4 f_color;\n"
+            "flat in uint f_instanceId;\n"
             "out vec4 color;\n"
+            "out uint instanceId;\n"
             "void main(void)\n"
             "{\n"
             "    color = f_color;\n"
+            "    instanceId = f_instanceId;\n"
             "}\n";
 
         m_programId = sCreateShaderProgram(vs, fs);
         m_projectionUniform = glGetUniformLocation(m_programId, "projectionMatrix");
         m_vertexAttribute = 0;
         m_colorAttribute = 1;
+        m_instanceIdAttribute = 2;
 
         // Generate
         glGenVertexArrays(1, &m_vaoId);
-        glGenBuffers(2, m_vboIds);
+        glGenBuffers(3, m_vboIds);
 
         glBindVertexArray(m_vaoId);
         glEnableVertexAttribArray(m_vertexAttribute);
         glEnableVertexAttribArray(m_colorAttribute);
+        glEnableVertexAttribArray(m_instanceIdAttribute);
 
         // Vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[0]);
@@ -631,6 +977,10 @@ struct GLRenderTriangles
         glVertexAttribPointer(m_colorAttribute, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
         glBufferData(GL_ARRAY_BUFFER, sizeof(m_colors), m_colors, GL_DYNAMIC_DRAW);
 
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[2]);
+        glVertexAttribIPointer(m_instanceIdAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+        glBufferData(GL_ARRAY_BUFFER, sizeof(m_instanceIds), m_instanceIds, GL_DYNAMIC_DRAW);
+
         sCheckGLError();
 
         // Cleanup
@@ -638,6 +988,7 @@ struct GLRenderTriangles
         glBindVertexArray(0);
 
         m_count = 0;
+        m_instanceId = 0;
     }
 
     void Destroy()
@@ -645,7 +996,7 @@ struct GLRenderTriangles
         if (m_vaoId)
         {
             glDeleteVertexArrays(1, &m_vaoId);
-            glDeleteBuffers(2, m_vboIds);
+            glDeleteBuffers(3, m_vboIds);
             m_vaoId = 0;
         }
 
@@ -663,6 +1014,7 @@ struct GLRenderTriangles
 
         m_vertices[m_count] = v;
         m_colors[m_count] = c;
+        m_instanceIds[m_count] = m_instanceId;
         ++m_count;
     }
 
@@ -686,6 +1038,9 @@ struct GLRenderTriangles
         glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[1]);
         glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(b2Color), m_colors);
         
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboIds[2]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_count * sizeof(uint32), m_instanceIds);
+        
         glEnable(GL_BLEND);
         glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glDrawArrays(GL_TRIANGLES, 0, m_count);
@@ -703,113 +1058,982 @@ struct GLRenderTriangles
     enum { e_maxVertices = 3 * 512 };
     b2Vec2 m_vertices[e_maxVertices];
     b2Color m_colors[e_maxVertices];
+    uint32 m_instanceIds[e_maxVertices];
 
     int32 m_count;
+    uint32 m_instanceId; // of the following vertices
 
     GLuint m_vaoId;
-    GLuint m_vboIds[2];
+    GLuint m_vboIds[3];
     GLuint m_programId;
     GLint m_projectionUniform;
     GLint m_vertexAttribute;
     GLint m_colorAttribute;
+    GLint m_instanceIdAttribute;
 };
 #endif
 
-//
-SimulationRenderer::SimulationRenderer()
-{
-    m_points = NULL;
-    m_lines = NULL;
-    m_triangles = NULL;
-    
-    m_bIsDebugMode = false;
-}
-
-//
-SimulationRenderer::~SimulationRenderer()
+// Instance ids are drawn into GL_COLOR_ATTACHMENT1, as GL_R16UI. Integer attachments cannot
+// take part in a blit of the colour attachment, so copies select one attachment at a time.
+static const GLenum sColorAndInstanceIdBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+static const GLenum sColorBuffer[2] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+static const GLenum sInstanceIdBuffer[2] = { GL_NONE, GL_COLOR_ATTACHMENT1 };
+static const GLuint sNoInstanceId[4] = { 0, 0, 0, 0 };
+
+// Static bodies are rendered into an offscreen layer once and blitted into every frame.
+// The layer matches the viewport, so each pixel (and sample) is copied as is.
+// The layer has its own depth buffer so overlapping static bodies resolve as before, the
+// copy itself leaves the depth buffer alone and the dynamic bodies are drawn over it.
+// With instance ids the layer keeps them too, the frame then has an id attachment as well.
+struct GLStaticLayer
 {
-    if (m_PixelBuffer != NULL)
+    void Create()
     {
-        free(m_PixelBuffer);
-        m_PixelBuffer = NULL;
+        m_fboId = 0;
+        m_colorBufferId = 0;
+        m_depthBufferId = 0;
+        m_instanceIdBufferId = 0;
+        m_bInstanceIds = false;
+        m_width = 0;
+        m_height = 0;
+        m_samples = 0;
+        m_bValid = false;
     }
-}
-
-//
-void SimulationRenderer::Create()
-{
-    m_points = new GLRenderPoints;
-    m_points->Create();
-    m_lines = new GLRenderLines;
-    m_lines->Create();
-    m_triangles = new GLRenderTriangles;
-    m_triangles->Create();
-}
-
-//
-void SimulationRenderer::Destroy()
-{
-    m_points->Destroy();
-    delete m_points;
-    m_points = NULL;
-
-    m_lines->Destroy();
-    delete m_lines;
-    m_lines = NULL;
-
-    m_triangles->Destroy();
-    delete m_triangles;
-    m_triangles = NULL;
-}
-
-//
-void SimulationRenderer::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
-{
-    b2Vec2 p1 = vertices[vertexCount - 1];
-    for (int32 i = 0; i < vertexCount; ++i)
+    
+    void Destroy()
     {
-        b2Vec2 p2 = vertices[i];
-        m_lines->Vertex(p1, color);
-        m_lines->Vertex(p2, color);
-        p1 = p2;
+        if (m_fboId)
+        {
+            glDeleteFramebuffers(1, &m_fboId);
+            glDeleteRenderbuffers(1, &m_colorBufferId);
+            glDeleteRenderbuffers(1, &m_depthBufferId);
+            glDeleteRenderbuffers(1, &m_instanceIdBufferId);
+            m_fboId = 0;
+            m_colorBufferId = 0;
+            m_depthBufferId = 0;
+            m_instanceIdBufferId = 0;
+        }
+        
+        m_bValid = false;
     }
-}
-
-void SimulationRenderer::DrawTexturedPolygon(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, const b2Color& color, uint32 glTexId, int matTexId)
-{
-#if RENDER_TEXTURES
-    const float transConst = m_bIsDebugMode ? 0.5 : 1.0;
-    b2Color fillColor(transConst * color.r, transConst * color.g, transConst * color.b, transConst);
     
-    m_triangles->m_textureIds[matTexId] = glTexId;
-
-    for (int32 i = 1; i < vertexCount - 1; ++i)
+    // The key hashes body addresses, which the next world can reuse.
+    void Invalidate()
     {
-        m_triangles->Vertex(vertices[0], fillColor, textureCoordinates[0], matTexId);
-        m_triangles->Vertex(vertices[i], fillColor, textureCoordinates[i], matTexId);
-        m_triangles->Vertex(vertices[i+1], fillColor, textureCoordinates[i+1], matTexId);
+        m_bValid = false;
     }
-
-    if(m_bIsDebugMode) {
-        b2Vec2 p1 = vertices[vertexCount - 1];
-        for (int32 i = 0; i < vertexCount; ++i)
+    
+    void SetInstanceIds(bool enabled)
+    {
+        if (enabled != m_bInstanceIds)
         {
-            b2Vec2 p2 = vertices[i];
-            m_lines->Vertex(p1, color);
-            m_lines->Vertex(p2, color);
-            p1 = p2;
+            Destroy();
+            m_bInstanceIds = enabled;
         }
     }
-#else
-    DrawSolidPolygon(vertices, vertexCount, color);
-#endif
-}
+    
+    // The layer is drawn with the camera, viewport and sample count of the frame it was cached in.
+    bool IsValid(uint32 key) const
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLint samples;
+        glGetIntegerv(GL_SAMPLES, &samples);
+        
+        return m_bValid
+            && m_key == key
+            && m_viewport[0] == viewport[0]
+            && m_viewport[1] == viewport[1]
+            && m_viewport[2] == viewport[2]
+            && m_viewport[3] == viewport[3]
+            && m_samples == samples
+            && m_cameraCenter == g_camera.m_center
+            && m_cameraZoom == g_camera.m_zoom;
+    }
+    
+    // Redirects drawing into the layer, cleared to the current clear colour. The layer is
+    // multisampled like the frame's framebuffer, so it can be copied in without a resolve.
+    // Multisampled copies cannot move pixels, so the layer is drawn at the position of the
+    // viewport, which is not the origin for a tile of an atlas.
+    void Begin(uint32 key)
+    {
+        glGetIntegerv(GL_VIEWPORT, m_viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFboId);
+        GLint samples;
+        glGetIntegerv(GL_SAMPLES, &samples);
+        const GLint width = m_viewport[0] + m_viewport[2];
+        const GLint height = m_viewport[1] + m_viewport[3];
+        
+        if (m_fboId == 0 || m_width != width || m_height != height || m_samples != samples)
+        {
+            if (m_fboId == 0)
+            {
+                glGenFramebuffers(1, &m_fboId);
+                glGenRenderbuffers(1, &m_colorBufferId);
+                glGenRenderbuffers(1, &m_depthBufferId);
+                if (m_bInstanceIds)
+                    glGenRenderbuffers(1, &m_instanceIdBufferId);
+            }
+            m_width = width;
+            m_height = height;
+            m_samples = samples;
+            
+            glBindRenderbuffer(GL_RENDERBUFFER, m_colorBufferId);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_RGBA8, m_width, m_height);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_depthBufferId);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT24, m_width, m_height);
+            if (m_bInstanceIds)
+            {
+                glBindRenderbuffer(GL_RENDERBUFFER, m_instanceIdBufferId);
+                glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_R16UI, m_width, m_height);
+            }
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fboId);
+            glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBufferId);
+            glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBufferId);
+            if (m_bInstanceIds)
+            {
+                glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, m_instanceIdBufferId);
+                glDrawBuffers(2, sColorAndInstanceIdBuffers);
+            }
+            if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                fprintf(stderr, "Static layer framebuffer is incomplete\n");
+            }
+        }
+        
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fboId);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (m_bInstanceIds)
+            glClearBufferuiv(GL_COLOR, 1, sNoInstanceId);
+        
+        m_key = key;
+        m_cameraCenter = g_camera.m_center;
+        m_cameraZoom = g_camera.m_zoom;
+    }
+    
+    void End()
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_previousFboId);
+        m_bValid = true;
+        
+        sCheckGLError();
+    }
+    
+    // Overwrites the whole viewport, so it has to come first in the frame.
+    void Draw()
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLint readFboId;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fboId);
+        if (m_bInstanceIds)
+        {
+            // Colour and ids have to be copied one attachment at a time.
+            glDrawBuffers(2, sColorBuffer);
+        }
+        glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                          viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        if (m_bInstanceIds)
+        {
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            glDrawBuffers(2, sInstanceIdBuffer);
+            glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                              viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glDrawBuffers(2, sColorAndInstanceIdBuffers);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+        
+        sCheckGLError();
+    }
+    
+    GLuint m_fboId;
+    GLuint m_colorBufferId;
+    GLuint m_depthBufferId;
+    GLuint m_instanceIdBufferId;
+    GLint m_width;
+    GLint m_height;
+    GLint m_samples;
+    bool m_bInstanceIds;
+    
+    bool m_bValid;
+    uint32 m_key;
+    b2Vec2 m_cameraCenter;
+    float32 m_cameraZoom;
+    
+    GLint m_viewport[4];
+    GLint m_previousFboId;
+};
+
+// Anti-aliased frames are drawn into an offscreen target instead of the output framebuffer:
+// multisampled with the given sample count, and/or supersampled at scale times the output
+// size. Resolve copies the frame into the output framebuffer before it is read back. The
+// samples are resolved with a blit and supersampled frames are box filtered down by halving
+// their size with linear blits, each of which averages 2x2 pixels.
+// Instance ids need the target too. They are resolved by picking a sample, and scaled down
+// to the output size in one nearest blit into a framebuffer of their own for the readback.
+struct GLRenderTarget
+{
+    struct Level
+    {
+        GLuint fboId;
+        GLuint colorBufferId;
+        GLuint depthBufferId;
+        GLuint instanceIdBufferId;
+        GLint width;
+        GLint height;
+    };
+    
+    void Create()
+    {
+        m_samples = 0;
+        m_scale = 1;
+        m_bInstanceIds = false;
+        m_instanceIdFboId = 0;
+        m_instanceIdBufferId = 0;
+        m_width = 0;
+        m_height = 0;
+        m_outputFboId = 0;
+        m_bBound = false;
+    }
+    
+    void Destroy()
+    {
+        DestroyLevels();
+    }
+    
+    // Samples is 0 for no multisampling, scale a power of two.
+    void Configure(int samples, int scale)
+    {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        if (m_bInstanceIds)
+        {
+            GLint maxIntegerSamples = 0;
+            glGetIntegerv(GL_MAX_INTEGER_SAMPLES, &maxIntegerSamples);
+            maxSamples = b2Min(maxSamples, maxIntegerSamples);
+        }
+        if (samples > maxSamples)
+        {
+            fprintf(stderr, "%d samples are not supported, using %d\n", samples, maxSamples);
+            samples = maxSamples;
+        }
+        
+        m_samples = samples;
+        m_scale = scale > 1 ? scale : 1;
+        DestroyLevels();
+    }
+    
+    // Adds an instance id attachment to the frame. Call before Configure.
+    void SetInstanceIds(bool enabled)
+    {
+        m_bInstanceIds = enabled;
+        DestroyLevels();
+    }
+    
+    bool IsEnabled() const
+    {
+        return m_samples > 0 || m_scale > 1 || m_bInstanceIds;
+    }
+    
+    // Binds the target for a width x height output frame and sets the viewport to it.
+    void Begin(GLint width, GLint height)
+    {
+        if (!IsEnabled())
+        {
+            glViewport(0, 0, width, height);
+            return;
+        }
+        
+        if (!m_bBound)
+        {
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_outputFboId);
+        }
+        
+        if (m_levels.empty() || m_width != width || m_height != height)
+        {
+            CreateLevels(width, height);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, m_levels[0].fboId);
+        glViewport(0, 0, m_levels[0].width, m_levels[0].height);
+        m_bBound = true;
+    }
+    
+    // Sets the viewport to a part of the output frame, scaled like the level drawn into.
+    void SetViewport(GLint x, GLint y, GLint width, GLint height)
+    {
+        const GLint scale = IsEnabled() ? m_scale : 1;
+        glViewport(x * scale, y * scale, width * scale, height * scale);
+    }
+    
+    // Copies the frame into the output framebuffer, which is left bound for the readback.
+    void Resolve()
+    {
+        if (!m_bBound)
+            return;
+        
+        if (m_bInstanceIds)
+        {
+            ResolveInstanceIds();
+        }
+        
+        for (size_t i = 0; i < m_levels.size(); ++i)
+        {
+            const Level& source = m_levels[i];
+            const GLint width = i + 1 < m_levels.size() ? m_levels[i + 1].width : m_width;
+            const GLint height = i + 1 < m_levels.size() ? m_levels[i + 1].height : m_height;
+            
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fboId);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, i + 1 < m_levels.size() ? m_levels[i + 1].fboId : m_outputFboId);
+            glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                              width == source.width ? GL_NEAREST : GL_LINEAR);
+        }
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, m_outputFboId);
+        glViewport(0, 0, m_width, m_height);
+        m_bBound = false;
+        
+        sCheckGLError();
+    }
+    
+    // Picks one sample per output pixel, ids must not be averaged.
+    void ResolveInstanceIds()
+    {
+        const Level& source = m_samples > 0 ? m_levels[1] : m_levels[0];
+        if (m_samples > 0)
+        {
+            BlitInstanceIds(m_levels[0], source.fboId, source.width, source.height);
+            glDrawBuffers(2, sColorBuffer);
+        }
+        BlitInstanceIds(source, m_instanceIdFboId, m_width, m_height);
+    }
+    
+    void BlitInstanceIds(const Level& source, GLuint fboId, GLint width, GLint height)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fboId);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboId);
+        glDrawBuffers(2, sInstanceIdBuffer);
+        glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+    }
+    
+    // Reads the ids of the last resolved frame into the bound pixel pack buffer, as
+    // width * height unsigned shorts.
+    void ReadInstanceIds()
+    {
+        GLint readFboId;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_instanceIdFboId);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glReadPixels(0, 0, m_width, m_height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, NULL);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+        
+        sCheckGLError();
+    }
+    
+    // The first level is drawn into. A multisampled first level is resolved into a single
+    // sampled level of the same size, whose format is known, as multisample blits need
+    // identical formats. Every further level halves the size down to twice the output.
+    void CreateLevels(GLint width, GLint height)
+    {
+        DestroyLevels();
+        m_width = width;
+        m_height = height;
+        
+        AddLevel(width * m_scale, height * m_scale, m_samples, true);
+        if (m_samples > 0)
+        {
+            AddLevel(width * m_scale, height * m_scale, 0, false);
+        }
+        for (int scale = m_scale / 2; scale > 1; scale /= 2)
+        {
+            AddLevel(width * scale, height * scale, 0, false);
+        }
+        
+        if (m_bInstanceIds)
+        {
+            glGenFramebuffers(1, &m_instanceIdFboId);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_instanceIdFboId);
+            glGenRenderbuffers(1, &m_instanceIdBufferId);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_instanceIdBufferId);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_R16UI, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, m_instanceIdBufferId);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glDrawBuffers(2, sInstanceIdBuffer);
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                fprintf(stderr, "Instance id framebuffer is incomplete\n");
+            }
+        }
+    }
+    
+    // The level drawn into has depth, and like the multisample resolve level it has ids if enabled.
+    void AddLevel(GLint width, GLint height, GLint samples, bool isDrawnInto)
+    {
+        const bool hasDepth = isDrawnInto;
+        const bool hasInstanceIds = m_bInstanceIds && (isDrawnInto || (m_levels.size() == 1 && m_samples > 0));
+        
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.depthBufferId = 0;
+        level.instanceIdBufferId = 0;
+        
+        glGenFramebuffers(1, &level.fboId);
+        glBindFramebuffer(GL_FRAMEBUFFER, level.fboId);
+        
+        glGenRenderbuffers(1, &level.colorBufferId);
+        glBindRenderbuffer(GL_RENDERBUFFER, level.colorBufferId);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, level.colorBufferId);
+        
+        if (hasDepth)
+        {
+            glGenRenderbuffers(1, &level.depthBufferId);
+            glBindRenderbuffer(GL_RENDERBUFFER, level.depthBufferId);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, level.depthBufferId);
+        }
+        
+        if (hasInstanceIds)
+        {
+            glGenRenderbuffers(1, &level.instanceIdBufferId);
+            glBindRenderbuffer(GL_RENDERBUFFER, level.instanceIdBufferId);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_R16UI, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, level.instanceIdBufferId);
+            glDrawBuffers(2, isDrawnInto ? sColorAndInstanceIdBuffers : sColorBuffer);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            fprintf(stderr, "Render target framebuffer is incomplete\n");
+        }
+        
+        m_levels.push_back(level);
+    }
+    
+    void DestroyLevels()
+    {
+        for (Level& level : m_levels)
+        {
+            glDeleteFramebuffers(1, &level.fboId);
+            glDeleteRenderbuffers(1, &level.colorBufferId);
+            if (level.depthBufferId)
+                glDeleteRenderbuffers(1, &level.depthBufferId);
+            if (level.instanceIdBufferId)
+                glDeleteRenderbuffers(1, &level.instanceIdBufferId);
+        }
+        m_levels.clear();
+        
+        if (m_instanceIdFboId)
+        {
+            glDeleteFramebuffers(1, &m_instanceIdFboId);
+            glDeleteRenderbuffers(1, &m_instanceIdBufferId);
+            m_instanceIdFboId = 0;
+            m_instanceIdBufferId = 0;
+        }
+    }
+    
+    std::vector<Level> m_levels;
+    GLint m_samples;
+    GLint m_scale;
+    GLint m_width;
+    GLint m_height;
+    
+    bool m_bInstanceIds;
+    GLuint m_instanceIdFboId;
+    GLuint m_instanceIdBufferId;
+    
+    GLint m_outputFboId;
+    bool m_bBound;
+};
+
+// Converts the resolved frame to YUV420P on the GPU for the video encoders, so that they get
+// 1.5 instead of 3 bytes per pixel and skip the CPU conversion. The planes are drawn into one
+// R8 target in the order of their rows in memory, already flipped top-down: Y at full size,
+// with U on the left and V on the right of the half-size rows above it.
+struct GLYuvConverter
+{
+    void Create()
+    {
+        // A single triangle covering the viewport.
+        const char* vs = \
+        "#version 330\n"
+        "void main(void)\n"
+        "{\n"
+        "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+        "    gl_Position = vec4(2.0f * p - 1.0f, 0.0f, 1.0f);\n"
+        "}\n";
+        
+        // BT.601 limited range, like sws_scale for RGB24 to YUV420P. Chroma is the mean of 2x2 pixels.
+        const char* fs = \
+        "#version 330\n"
+        "uniform sampler2D frame;\n"
+        "out vec4 color;\n"
+        "vec3 fetch(ivec2 size, int x, int y)\n"
+        "{\n"
+        "    return texelFetch(frame, ivec2(x, size.y - 1 - y), 0).rgb;\n"
+        "}\n"
+        "void main(void)\n"
+        "{\n"
+        "    ivec2 size = textureSize(frame, 0);\n"
+        "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+        "    if (p.y < size.y)\n"
+        "    {\n"
+        "        float y = dot(fetch(size, p.x, p.y), vec3(0.256788f, 0.504129f, 0.097906f));\n"
+        "        color = vec4(y + 16.0f / 255.0f, 0.0f, 0.0f, 1.0f);\n"
+        "        return;\n"
+        "    }\n"
+        "    int halfWidth = size.x / 2;\n"
+        "    bool isV = p.x >= halfWidth;\n"
+        "    int x = 2 * (isV ? p.x - halfWidth : p.x);\n"
+        "    int y = 2 * (p.y - size.y);\n"
+        "    vec3 rgb = 0.25f * (fetch(size, x, y) + fetch(size, x + 1, y) + fetch(size, x, y + 1) + fetch(size, x + 1, y + 1));\n"
+        "    float c = isV ? dot(rgb, vec3(0.439216f, -0.367788f, -0.071427f))\n"
+        "                  : dot(rgb, vec3(-0.148223f, -0.290993f, 0.439216f));\n"
+        "    color = vec4(c + 128.0f / 255.0f, 0.0f, 0.0f, 1.0f);\n"
+        "}\n";
+        
+        m_programId = sCreateShaderProgram(vs, fs);
+        m_frameUniform = glGetUniformLocation(m_programId, "frame");
+        glGenVertexArrays(1, &m_vaoId);
+        
+        m_rgbFboId = 0;
+        m_rgbTextureId = 0;
+        m_yuvFboId = 0;
+        m_yuvTextureId = 0;
+        m_width = 0;
+        m_height = 0;
+        
+        sCheckGLError();
+    }
+    
+    void Destroy()
+    {
+        DestroyTargets();
+        if (m_vaoId)
+        {
+            glDeleteVertexArrays(1, &m_vaoId);
+            m_vaoId = 0;
+        }
+        if (m_programId)
+        {
+            glDeleteProgram(m_programId);
+            m_programId = 0;
+        }
+    }
+    
+    // Converts the width x height frame in the bound read framebuffer and reads the planes into
+    // the bound pixel pack buffer, as width * height * 3 / 2 bytes. Width and height must be even.
+    void Convert(GLint width, GLint height)
+    {
+        GLint readFboId;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
+        GLint drawFboId;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        
+        if (m_rgbFboId == 0 || m_width != width || m_height != height)
+        {
+            CreateTargets(width, height);
+        }
+        
+        // Render buffers and the default framebuffer cannot be sampled, copy the frame into a texture.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_rgbFboId);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, m_yuvFboId);
+        glViewport(0, 0, width, height + height / 2);
+        glUseProgram(m_programId);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_rgbTextureId);
+        glUniform1i(m_frameUniform, 0);
+        glBindVertexArray(m_vaoId);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glUseProgram(0);
+        
+        const GLsizeiptr planeSize = (width / 2) * (height / 2);
+        glReadPixels(0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        glReadPixels(0, height, width / 2, height / 2, GL_RED, GL_UNSIGNED_BYTE, (void*)(GLsizeiptr)(width * height));
+        glReadPixels(width / 2, height, width / 2, height / 2, GL_RED, GL_UNSIGNED_BYTE, (void*)(GLsizeiptr)(width * height + planeSize));
+        
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        
+        sCheckGLError();
+    }
+    
+    void CreateTargets(GLint width, GLint height)
+    {
+        DestroyTargets();
+        m_width = width;
+        m_height = height;
+        
+        glGenTextures(1, &m_rgbTextureId);
+        glBindTexture(GL_TEXTURE_2D, m_rgbTextureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &m_rgbFboId);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_rgbFboId);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_rgbTextureId, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            fprintf(stderr, "YUV conversion framebuffer is incomplete\n");
+        }
+        
+        glGenTextures(1, &m_yuvTextureId);
+        glBindTexture(GL_TEXTURE_2D, m_yuvTextureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height + height / 2, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        glGenFramebuffers(1, &m_yuvFboId);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_yuvFboId);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_yuvTextureId, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            fprintf(stderr, "YUV conversion framebuffer is incomplete\n");
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    
+    void DestroyTargets()
+    {
+        if (m_rgbFboId)
+        {
+            glDeleteFramebuffers(1, &m_rgbFboId);
+            glDeleteTextures(1, &m_rgbTextureId);
+            glDeleteFramebuffers(1, &m_yuvFboId);
+            glDeleteTextures(1, &m_yuvTextureId);
+            m_rgbFboId = 0;
+            m_rgbTextureId = 0;
+            m_yuvFboId = 0;
+            m_yuvTextureId = 0;
+        }
+    }
+    
+    GLuint m_programId;
+    GLint m_frameUniform;
+    GLuint m_vaoId;
+    
+    GLuint m_rgbFboId;
+    GLuint m_rgbTextureId;
+    GLuint m_yuvFboId;
+    GLuint m_yuvTextureId;
+    GLint m_width;
+    GLint m_height;
+};
+
+//
+SimulationRenderer::SimulationRenderer()
+{
+    m_points = NULL;
+    m_lines = NULL;
+    m_triangles = NULL;
+    m_meshes = NULL;
+    m_staticLayer = NULL;
+    m_renderTarget = NULL;
+    m_yuvConverter = NULL;
+    m_bYuvReadback = false;
+    m_pSoftwareRenderer = NULL;
+    m_pFrameArrayWriter = NULL;
+    m_pImageWriter = new ImageWriter;
+    m_nFrameImageInterval = 0;
+    m_nInstanceMaskInterval = 1;
+    m_nAtlasColumns = 0;
+    m_nAtlasRows = 0;
+    m_pAtlas = NULL;
+    m_nTileIndex = 0;
+    m_nTileX = 0;
+    m_nTileY = 0;
+    
+    m_bIsDebugMode = false;
+}
+
+//
+SimulationRenderer::~SimulationRenderer()
+{
+    CloseVideoOutputs();
+    delete m_pFrameArrayWriter;
+    m_pFrameArrayWriter = NULL;
+    delete m_pImageWriter;
+    m_pImageWriter = NULL;
+
+    if (m_PixelBuffer != NULL)
+    {
+        free(m_PixelBuffer);
+        m_PixelBuffer = NULL;
+    }
+    
+    for (SimulationRenderer* tile : m_Tiles)
+    {
+        delete tile;
+    }
+    m_Tiles.clear();
+}
+
+//
+void SimulationRenderer::Create()
+{
+    // The tiles are sized by the outputs of their simulations, which all have the same size.
+    if (isAtlas() && !m_Tiles.empty())
+    {
+        m_nWidth = m_nAtlasColumns * m_Tiles[0]->m_nWidth;
+        m_nHeight = m_nAtlasRows * m_Tiles[0]->m_nHeight;
+    }
+    
+    m_points = new GLRenderPoints;
+    m_points->Create();
+    m_lines = new GLRenderLines;
+    m_lines->Create();
+    m_triangles = new GLRenderTriangles;
+    m_triangles->Create();
+#if RENDER_TEXTURES
+    m_meshes = new GLRenderMeshes;
+    m_meshes->Create();
+#endif
+    m_staticLayer = new GLStaticLayer;
+    m_staticLayer->Create();
+    m_renderTarget = new GLRenderTarget;
+    m_renderTarget->Create();
+    
+    m_staticLayer->SetInstanceIds(writingInstanceMasks());
+    m_renderTarget->SetInstanceIds(writingInstanceMasks());
+    
+    if (m_bYuvReadback)
+    {
+        m_yuvConverter = new GLYuvConverter;
+        m_yuvConverter->Create();
+    }
+
+    CreatePixelPackBuffers();
+    
+    for (int i = 0; i < (int)m_Tiles.size(); ++i)
+    {
+        SimulationRenderer* tile = m_Tiles[i];
+        tile->CreateTile(this, (i % m_nAtlasColumns) * tile->m_nWidth, (i / m_nAtlasColumns) * tile->m_nHeight);
+    }
+}
+
+void SimulationRenderer::Reconfigure()
+{
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->InvalidateStaticLayer();
+        m_nFramesRead = 0;
+        m_nFramesResolved = 0;
+        m_PendingImages.clear();
+        return;
+    }
+    
+    m_staticLayer->SetInstanceIds(writingInstanceMasks());
+    m_staticLayer->Invalidate();
+    m_renderTarget->SetInstanceIds(writingInstanceMasks());
+    
+    if (m_bYuvReadback && m_yuvConverter == NULL)
+    {
+        m_yuvConverter = new GLYuvConverter;
+        m_yuvConverter->Create();
+    }
+    else if (!m_bYuvReadback && m_yuvConverter != NULL)
+    {
+        m_yuvConverter->Destroy();
+        delete m_yuvConverter;
+        m_yuvConverter = NULL;
+    }
+    
+    DestroyPixelPackBuffers();
+    CreatePixelPackBuffers();
+}
+
+void SimulationRenderer::setAtlas(const int& columns, const int& rows)
+{
+    m_nAtlasColumns = columns;
+    m_nAtlasRows = rows;
+}
+
+SimulationRenderer* SimulationRenderer::AddTile()
+{
+    SimulationRenderer* tile = new SimulationRenderer;
+    tile->m_pAtlas = this;
+    tile->m_nTileIndex = (int)m_Tiles.size();
+    m_Tiles.push_back(tile);
+    return tile;
+}
+
+// Draws with the batches of the atlas, which flushes them with the projection of the tile.
+void SimulationRenderer::CreateTile(SimulationRenderer* atlas, const int& x, const int& y)
+{
+    m_points = atlas->m_points;
+    m_lines = atlas->m_lines;
+    m_triangles = atlas->m_triangles;
+    m_meshes = atlas->m_meshes;
+    m_staticLayer = new GLStaticLayer;
+    m_staticLayer->Create();
+    m_nTileX = x;
+    m_nTileY = y;
+}
+
+//
+void SimulationRenderer::CreateSoftware()
+{
+    m_pSoftwareRenderer = new SoftwareRenderer;
+    m_pSoftwareRenderer->setIsDebugMode(m_bIsDebugMode);
+
+    const std::vector<std::string> imageFilePaths = SimulationMaterial::getImageFilePaths();
+    for (int i = 0; i < (int)imageFilePaths.size(); ++i)
+    {
+        if (imageFilePaths[i] != "")
+            m_pSoftwareRenderer->setMaterialImage(i, imageFilePaths[i]);
+    }
+}
+
+//
+void SimulationRenderer::Destroy()
+{
+    if (m_pSoftwareRenderer)
+    {
+        delete m_pSoftwareRenderer;
+        m_pSoftwareRenderer = NULL;
+        return;
+    }
+    
+    // The batches belong to the atlas.
+    if (m_pAtlas)
+    {
+        m_points = NULL;
+        m_lines = NULL;
+        m_triangles = NULL;
+        m_meshes = NULL;
+        m_staticLayer->Destroy();
+        delete m_staticLayer;
+        m_staticLayer = NULL;
+        return;
+    }
+    
+    for (SimulationRenderer* tile : m_Tiles)
+    {
+        tile->Destroy();
+    }
+
+    DestroyPixelPackBuffers();
+
+    m_points->Destroy();
+    delete m_points;
+    m_points = NULL;
+
+    m_lines->Destroy();
+    delete m_lines;
+    m_lines = NULL;
+
+    m_triangles->Destroy();
+    delete m_triangles;
+    m_triangles = NULL;
+
+#if RENDER_TEXTURES
+    m_meshes->Destroy();
+    delete m_meshes;
+    m_meshes = NULL;
+#endif
+
+    m_staticLayer->Destroy();
+    delete m_staticLayer;
+    m_staticLayer = NULL;
+
+    m_renderTarget->Destroy();
+    delete m_renderTarget;
+    m_renderTarget = NULL;
+    
+    if (m_yuvConverter)
+    {
+        m_yuvConverter->Destroy();
+        delete m_yuvConverter;
+        m_yuvConverter = NULL;
+    }
+}
+
+//
+void SimulationRenderer::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawPolygon(vertices, vertexCount, color);
+        return;
+    }
+
+    b2Vec2 p1 = vertices[vertexCount - 1];
+    for (int32 i = 0; i < vertexCount; ++i)
+    {
+        b2Vec2 p2 = vertices[i];
+        m_lines->Vertex(p1, color);
+        m_lines->Vertex(p2, color);
+        p1 = p2;
+    }
+}
+
+void SimulationRenderer::DrawTexturedPolygon(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, const b2Color& color, uint32 glTexId, int matTexId)
+{
+#if RENDER_TEXTURES
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawTexturedPolygon(vertices, textureCoordinates, vertexCount, color, glTexId, matTexId);
+        return;
+    }
+
+    const float transConst = m_bIsDebugMode ? 0.5 : 1.0;
+    b2Color fillColor(transConst * color.r, transConst * color.g, transConst * color.b, transConst);
+    
+    // Mesh instances queued before this polygon have to be drawn below it.
+    m_meshes->Flush();
+    if (glTexId > 0)
+        m_triangles->m_textureId = glTexId;
+
+    for (int32 i = 1; i < vertexCount - 1; ++i)
+    {
+        m_triangles->Vertex(vertices[0], fillColor, textureCoordinates[0], matTexId);
+        m_triangles->Vertex(vertices[i], fillColor, textureCoordinates[i], matTexId);
+        m_triangles->Vertex(vertices[i+1], fillColor, textureCoordinates[i+1], matTexId);
+    }
+
+    if(m_bIsDebugMode) {
+        b2Vec2 p1 = vertices[vertexCount - 1];
+        for (int32 i = 0; i < vertexCount; ++i)
+        {
+            b2Vec2 p2 = vertices[i];
+            m_lines->Vertex(p1, color);
+            m_lines->Vertex(p2, color);
+            p1 = p2;
+        }
+    }
+#else
+    DrawSolidPolygon(vertices, vertexCount, color);
+#endif
+}
 
 //
 void SimulationRenderer::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
 {
 #if RENDER_TEXTURES
 #else
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawSolidPolygon(vertices, vertexCount, color);
+        return;
+    }
+
     const float transConst = m_bIsDebugMode ? 0.5 : 1.0;
     b2Color fillColor(transConst * color.r, transConst * color.g, transConst * color.b, transConst);
 
@@ -836,6 +2060,12 @@ void SimulationRenderer::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCo
 //
 void SimulationRenderer::DrawCircle(const b2Vec2& center, float32 radius, const b2Color& color)
 {
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawCircle(center, radius, color);
+        return;
+    }
+
     const float32 k_segments = 16.0f;
     const float32 k_increment = 2.0f * b2_pi / k_segments;
     float32 sinInc = sinf(k_increment);
@@ -859,6 +2089,12 @@ void SimulationRenderer::DrawCircle(const b2Vec2& center, float32 radius, const
 void SimulationRenderer::DrawTexturedCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color, uint32 glTexId, int matTexId)
 {
 #if RENDER_TEXTURES
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawTexturedCircle(center, radius, axis, color, glTexId, matTexId);
+        return;
+    }
+
     const float32 k_segments = 16.0f;
     const float32 k_increment = 2.0f * b2_pi / k_segments;
     float32 sinInc = sinf(k_increment);
@@ -868,7 +2104,9 @@ void SimulationRenderer::DrawTexturedCircle(const b2Vec2& center, float32 radius
     b2Vec2 v1 = center + radius * r1;
     b2Color fillColor(0.5f * color.r, 0.5f * color.g, 0.5f * color.b, 0.5f);
     
-    m_triangles->m_textureIds[matTexId] = glTexId;
+    m_meshes->Flush();
+    if (glTexId > 0)
+        m_triangles->m_textureId = glTexId;
     
     for (int32 i = 0; i < k_segments; ++i)
     {
@@ -913,6 +2151,12 @@ void SimulationRenderer::DrawSolidCircle(const b2Vec2& center, float32 radius, c
 {
 #if RENDER_TEXTURES
 #else
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawSolidCircle(center, radius, axis, color);
+        return;
+    }
+
     const float32 k_segments = 16.0f;
     const float32 k_increment = 2.0f * b2_pi / k_segments;
     float32 sinInc = sinf(k_increment);
@@ -961,6 +2205,12 @@ void SimulationRenderer::DrawSolidCircle(const b2Vec2& center, float32 radius, c
 //
 void SimulationRenderer::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
 {
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawSegment(p1, p2, color);
+        return;
+    }
+
     m_lines->Vertex(p1, color);
     m_lines->Vertex(p2, color);
 }
@@ -1012,9 +2262,94 @@ void SimulationRenderer::DrawTexturedRectangleChain(const b2Vec2& p1, const b2Ve
     DrawTexturedPolygon(vertices.data(), texCoords.data(), vertices.size(), color, glTexId, matTexId);
 }
 
+uint32 SimulationRenderer::CreateMesh(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, bool worldTextureCoordinates)
+{
+#if RENDER_TEXTURES
+    // Debug mode draws outlines from the world space vertices, so it stays immediate.
+    if (m_meshes == NULL || m_bIsDebugMode)
+        return 0;
+    
+    return m_meshes->CreateMesh(vertices, textureCoordinates, vertexCount, worldTextureCoordinates);
+#else
+    return 0;
+#endif
+}
+
+void SimulationRenderer::DestroyMesh(uint32 meshId)
+{
+#if RENDER_TEXTURES
+    // Worlds may outlive the GL objects, the meshes are gone with them then.
+    if (m_meshes)
+        m_meshes->DestroyMesh(meshId);
+#endif
+}
+
+void SimulationRenderer::DrawMesh(uint32 meshId, const b2Transform& xf, const b2Color& color, uint32 glTexId, int matTexId)
+{
+#if RENDER_TEXTURES
+    b2Color fillColor(color.r, color.g, color.b, 1.0f);
+    
+    // Triangles queued before this body have to be drawn below it.
+    m_triangles->Flush();
+    if (glTexId > 0)
+        m_meshes->m_textureId = glTexId;
+    m_meshes->Instance(meshId, xf, fillColor, matTexId);
+#endif
+}
+
+bool SimulationRenderer::BeginStaticLayer(uint32 key)
+{
+    if (m_pSoftwareRenderer)
+        return m_pSoftwareRenderer->BeginStaticLayer(key);
+
+    if (m_staticLayer->IsValid(key))
+    {
+        m_staticLayer->Draw();
+        return false;
+    }
+    
+    m_staticLayer->Begin(key);
+    return true;
+}
+
+void SimulationRenderer::EndStaticLayer()
+{
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->EndStaticLayer();
+        return;
+    }
+
+    FlushBatches();
+    m_staticLayer->End();
+    m_staticLayer->Draw();
+}
+
+void SimulationRenderer::SetInstanceId(uint32 id)
+{
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->SetInstanceId(id);
+        return;
+    }
+    
+    m_points->m_instanceId = id;
+    m_lines->m_instanceId = id;
+    m_triangles->m_instanceId = id;
+#if RENDER_TEXTURES
+    m_meshes->m_instanceId = id;
+#endif
+}
+
 //
 void SimulationRenderer::DrawTransform(const b2Transform& xf)
 {
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawTransform(xf);
+        return;
+    }
+
     const float32 k_axisScale = 0.4f;
     b2Color red(1.0f, 0.0f, 0.0f);
     b2Color green(0.0f, 1.0f, 0.0f);
@@ -1032,6 +2367,12 @@ void SimulationRenderer::DrawTransform(const b2Transform& xf)
 //
 void SimulationRenderer::DrawPoint(const b2Vec2& p, float32 size, const b2Color& color)
 {
+    if (m_pSoftwareRenderer)
+    {
+        m_pSoftwareRenderer->DrawPoint(p, size, color);
+        return;
+    }
+
     m_points->Vertex(p, color, size);
 }
 
@@ -1069,6 +2410,13 @@ void SimulationRenderer::DrawAABB(b2AABB* aabb, const b2Color& c)
     b2Vec2 p3 = aabb->upperBound;
     b2Vec2 p4 = b2Vec2(aabb->lowerBound.x, aabb->upperBound.y);
     
+    if (m_pSoftwareRenderer)
+    {
+        const b2Vec2 vertices[4] = { p1, p2, p3, p4 };
+        m_pSoftwareRenderer->DrawPolygon(vertices, 4, c);
+        return;
+    }
+
     m_lines->Vertex(p1, c);
     m_lines->Vertex(p2, c);
 
@@ -1082,98 +2430,441 @@ void SimulationRenderer::DrawAABB(b2AABB* aabb, const b2Color& c)
     m_lines->Vertex(p1, c);
 }
 
-bool save_png_libpng(const char *filename, unsigned char* pixels, int w, int h)
+void SimulationRenderer::SaveAsImage(std::string path)
 {
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png)
-        return false;
+    if (!m_pSoftwareRenderer)
+        sCheckGLError();
+    
+    const int frame = m_nFramesRead - 1;
+    
+    // Frames only read back as YUV are still in the framebuffer until the next one begins. Tiles
+    // are always read back as RGB with the atlas frame, DeliverTiles serves their requests.
+    if (frame >= 0 && !m_pSoftwareRenderer && !m_pAtlas && !m_bRgbRead[frame % e_pixelPackBufferCount])
+    {
+        std::vector<unsigned char> pixels(3 * m_nWidth * m_nHeight);
+        glReadPixels(0, 0, m_nWidth, m_nHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        m_pImageWriter->Write(path, pixels.data());
+        return;
+    }
+    
+    if (frame < m_nFramesResolved)
+    {
+        m_pImageWriter->Write(path, m_PixelBuffer);
+        return;
+    }
+    
+    m_PendingImages.push_back(std::make_pair(frame, path));
+}
 
-    png_infop info = png_create_info_struct(png);
-    if (!info) {
-        png_destroy_write_struct(&png, &info);
-        return false;
+void SimulationRenderer::CreatePixelPackBuffers()
+{
+    const GLsizeiptr size = 3 * m_nWidth * m_nHeight;
+    
+    glGenBuffers(e_pixelPackBufferCount, m_pixelPackBufferIds);
+    for (int i = 0; i < e_pixelPackBufferCount; ++i)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelPackBufferIds[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    if (m_yuvConverter)
+    {
+        glGenBuffers(e_pixelPackBufferCount, m_yuvPackBufferIds);
+        for (int i = 0; i < e_pixelPackBufferCount; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_yuvPackBufferIds[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, size / 2, NULL, GL_STREAM_READ);
+        }
+    }
+    if (writingInstanceMasks())
+    {
+        glGenBuffers(e_pixelPackBufferCount, m_instanceIdPackBufferIds);
+        for (int i = 0; i < e_pixelPackBufferCount; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_instanceIdPackBufferIds[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, 2 * m_nWidth * m_nHeight, NULL, GL_STREAM_READ);
+        }
     }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    // Rows of RGB pixels are tightly packed in m_PixelBuffer.
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    m_nFramesRead = 0;
+    m_nFramesResolved = 0;
+    m_PendingImages.clear();
+}
 
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) {
-        png_destroy_write_struct(&png, &info);
-        return false;
+void SimulationRenderer::DestroyPixelPackBuffers()
+{
+    if (m_pixelPackBufferIds[0])
+    {
+        glDeleteBuffers(e_pixelPackBufferCount, m_pixelPackBufferIds);
+        memset(m_pixelPackBufferIds, 0, sizeof(m_pixelPackBufferIds));
+    }
+    if (m_yuvPackBufferIds[0])
+    {
+        glDeleteBuffers(e_pixelPackBufferCount, m_yuvPackBufferIds);
+        memset(m_yuvPackBufferIds, 0, sizeof(m_yuvPackBufferIds));
+    }
+    if (m_instanceIdPackBufferIds[0])
+    {
+        glDeleteBuffers(e_pixelPackBufferCount, m_instanceIdPackBufferIds);
+        memset(m_instanceIdPackBufferIds, 0, sizeof(m_instanceIdPackBufferIds));
+    }
+}
+
+// Maps the oldest frame in flight and hands it on.
+void SimulationRenderer::ResolveFrame()
+{
+    const GLsizeiptr size = 3 * m_nWidth * m_nHeight;
+    
+    if (IsInstanceMaskFrame(m_nFramesResolved))
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_instanceIdPackBufferIds[m_nFramesResolved % e_pixelPackBufferCount]);
+        void* ids = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 2 * m_nWidth * m_nHeight, GL_MAP_READ_BIT);
+        if (ids != NULL)
+        {
+            DeliverInstanceMask((const unsigned short*)ids);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    
+    const int slot = m_nFramesResolved % e_pixelPackBufferCount;
+    void* pixels = NULL;
+    void* yuv = NULL;
+    if (m_bRgbRead[slot])
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelPackBufferIds[slot]);
+        pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    }
+    if (m_bYuvRead[slot])
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_yuvPackBufferIds[slot]);
+        yuv = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size / 2, GL_MAP_READ_BIT);
+    }
+    
+    DeliverFrame((const unsigned char*)pixels, (const unsigned char*)yuv);
+    
+    if (yuv != NULL)
+    {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
     }
+    if (pixels != NULL)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelPackBufferIds[slot]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
-    png_init_io(png, fp);
-    png_set_IHDR(png, info, w, h, 8 /* depth */, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
-        PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-    png_colorp palette = (png_colorp)png_malloc(png, PNG_MAX_PALETTE_LENGTH * sizeof(png_color));
-    if (!palette) {
-        fclose(fp);
-        png_destroy_write_struct(&png, &info);
-        return false;
+// Hands the oldest frame not yet resolved to the video encoder and to the screenshots
+// requested for it, in the order the frames were drawn. pixels is NULL for frames only
+// read back as YUV, yuv for frames not read back as YUV.
+void SimulationRenderer::DeliverFrame(const unsigned char* pixels, const unsigned char* yuv)
+{
+    if (isAtlas())
+    {
+        DeliverTiles(pixels);
+        return;
+    }
+    
+    const size_t size = 3 * m_nWidth * m_nHeight;
+    
+    // The latest frame is kept around for SaveAsImage calls made after the ring is drained.
+    const bool keepPixels = m_nFramesResolved == m_nFramesRead - 1 && pixels != NULL;
+    
+    for (VideoWriter* writer : m_VideoWriters)
+    {
+        if (!writer->AcceptsFrame(m_nFramesResolved))
+            continue;
+        
+        if (UsesYuvReadback(writer)) {
+            if (yuv != NULL) {
+                memcpy(writer->AcquireFrame(), yuv, size / 2);
+                writer->SubmitYuvFrame();
+            }
+        }
+        else if (pixels != NULL) {
+            memcpy(writer->AcquireFrame(), pixels, size);
+            writer->SubmitFrame();
+        }
+    }
+    if (pixels == NULL) {
+        ++m_nFramesResolved;
+        return;
     }
-    png_set_PLTE(png, info, palette, PNG_MAX_PALETTE_LENGTH);
-    png_write_info(png, info);
-    png_set_packing(png);
+    
+    if (writingToFrameArray() && m_pFrameArrayWriter->AcceptsFrame(m_nFramesResolved)) {
+        m_pFrameArrayWriter->Write(pixels);
+    }
+    if (writingFrameImages()) {
+        if (m_nFramesResolved == 0) {
+            m_pImageWriter->Write(m_sFrameImageFolder + "first.png", pixels);
+        }
+        if (m_nFrameImageInterval > 0 && m_nFramesResolved % m_nFrameImageInterval == 0) {
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%06d.png", m_nFramesResolved);
+            m_pImageWriter->Write(m_sFrameImageFolder + name, pixels);
+        }
+    }
+    for (auto it = m_PendingImages.begin(); it != m_PendingImages.end(); )
+    {
+        if (it->first == m_nFramesResolved)
+        {
+            m_pImageWriter->Write(it->second, pixels);
+            it = m_PendingImages.erase(it);
+        }
+        else it++;
+    }
+    if (keepPixels) {
+        memcpy(m_PixelBuffer, pixels, size);
+    }
+    
+    ++m_nFramesResolved;
+}
 
-    png_bytepp rows = (png_bytepp)png_malloc(png, h * sizeof(png_bytep));
-    for (int i = 0; i < h; ++i)
-        rows[i] = (png_bytep)(pixels + (h - i - 1) * w * 3);
+// Splits an atlas frame up into the frames of the tiles that were drawn into it.
+void SimulationRenderer::DeliverTiles(const unsigned char* pixels)
+{
+    const std::vector<bool>& tilesDrawn = m_TilesDrawn[m_nFramesResolved % e_pixelPackBufferCount];
+    for (size_t i = 0; i < m_Tiles.size(); ++i)
+    {
+        if (!tilesDrawn[i])
+            continue;
+        
+        SimulationRenderer* tile = m_Tiles[i];
+        if (pixels == NULL)
+        {
+            tile->DeliverFrame(NULL, NULL);
+            continue;
+        }
+        
+        const size_t rowSize = 3 * tile->m_nWidth;
+        m_TilePixels.resize(rowSize * tile->m_nHeight);
+        for (int y = 0; y < tile->m_nHeight; ++y)
+        {
+            memcpy(&m_TilePixels[y * rowSize], pixels + 3 * ((tile->m_nTileY + y) * m_nWidth + tile->m_nTileX), rowSize);
+        }
+        tile->DeliverFrame(m_TilePixels.data(), NULL);
+    }
+    
+    ++m_nFramesResolved;
+}
 
-    png_write_image(png, rows);
-    png_write_end(png, info);
-    png_free(png, palette);
-    png_destroy_write_struct(&png, &info);
+// Written for the frame DeliverFrame hands on next.
+void SimulationRenderer::DeliverInstanceMask(const unsigned short* ids)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "mask_%06d.png", m_nFramesResolved);
+    m_pImageWriter->WriteInstanceMask(m_sInstanceMaskFolder + name, ids);
+}
 
-    fclose(fp);
-    delete[] rows;
-    return true;
+bool SimulationRenderer::UsesYuvReadback(const VideoWriter* writer) const
+{
+    return m_yuvConverter != NULL && writer->AcceptsYuvFrames();
 }
-    
-void SimulationRenderer::SaveAsImage(std::string path)
+
+// Without the YUV readback every frame is read as RGB, as before.
+bool SimulationRenderer::NeedsRgbFrame(const int& frame) const
 {
-    //glFlush();
-    //unsigned char* image = (unsigned char*)malloc(sizeof(unsigned char) * 3 * width * height);
-    //glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image);
+    if (m_yuvConverter == NULL)
+        return true;
     
-    sCheckGLError();
-    
-    flipVertically(m_PixelBuffer, m_nWidth, m_nHeight, 3);
-    save_png_libpng(path.c_str(), m_PixelBuffer, m_nWidth, m_nHeight);
-    flipVertically(m_PixelBuffer, m_nWidth, m_nHeight, 3);
+    if (m_sFrameImageFolder != "" && (frame == 0 || (m_nFrameImageInterval > 0 && frame % m_nFrameImageInterval == 0)))
+        return true;
+    if (m_pFrameArrayWriter != NULL && m_pFrameArrayWriter->AcceptsFrame(frame))
+        return true;
+    for (const VideoWriter* writer : m_VideoWriters)
+    {
+        if (!UsesYuvReadback(writer) && writer->AcceptsFrame(frame))
+            return true;
+    }
+    return false;
+}
+
+bool SimulationRenderer::NeedsYuvFrame(const int& frame) const
+{
+    for (const VideoWriter* writer : m_VideoWriters)
+    {
+        if (UsesYuvReadback(writer) && writer->AcceptsFrame(frame))
+            return true;
+    }
+    return false;
+}
+
+bool SimulationRenderer::IsInstanceMaskFrame(const int& frame) const
+{
+    return writingInstanceMasks() && frame % m_nInstanceMaskInterval == 0;
 }
 
 //
-void SimulationRenderer::Flush()
+void SimulationRenderer::FlushBatches()
 {
+#if RENDER_TEXTURES
+    m_meshes->Flush();
+#endif
     m_triangles->Flush();
     m_lines->Flush();
     m_points->Flush();
+}
+
+void SimulationRenderer::setYuvReadback(const bool& enabled)
+{
+    m_bYuvReadback = enabled;
+}
+
+void SimulationRenderer::setAntiAliasing(const int& samples, const int& supersampling)
+{
+    if (m_renderTarget)
+        m_renderTarget->Configure(samples, supersampling);
+}
+
+void SimulationRenderer::BeginFrame(const int& width, const int& height)
+{
+    // The atlas frame is already bound and cleared.
+    if (m_pAtlas)
+    {
+        m_pAtlas->m_renderTarget->SetViewport(m_nTileX, m_nTileY, width, height);
+        return;
+    }
+    
+    if (m_pSoftwareRenderer)
+    {
+        if (m_pSoftwareRenderer->getWidth() != width || m_pSoftwareRenderer->getHeight() != height)
+            m_pSoftwareRenderer->Resize(width, height);
+        m_pSoftwareRenderer->setCamera(g_camera.m_center, g_camera.m_zoom);
+        m_pSoftwareRenderer->Clear();
+        return;
+    }
+
+    m_renderTarget->Begin(width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    
+    if (isAtlas())
+    {
+        m_TilesDrawn[m_nFramesRead % e_pixelPackBufferCount].assign(m_Tiles.size(), false);
+    }
+}
 
-    unsigned int width = m_nWidth;
-    unsigned int height = m_nHeight;
+void SimulationRenderer::Flush()
+{
+    // Tiles are read back with the atlas frame. The batches are shared and drawn right away,
+    // before the next tile changes the viewport.
+    if (m_pAtlas)
+    {
+        FlushBatches();
+        m_pAtlas->m_TilesDrawn[m_pAtlas->m_nFramesRead % e_pixelPackBufferCount][m_nTileIndex] = true;
+        ++m_nFramesRead;
+        return;
+    }
     
-    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, m_PixelBuffer); 
+    // The frame is complete as soon as the last draw returns, there is nothing to wait for.
+    if (m_pSoftwareRenderer)
+    {
+        ++m_nFramesRead;
+        if (IsInstanceMaskFrame(m_nFramesResolved))
+            DeliverInstanceMask(m_pSoftwareRenderer->getInstanceIds());
+        DeliverFrame(m_pSoftwareRenderer->getPixels(), NULL);
+        return;
+    }
+
+    FlushBatches();
+    glDisable(GL_DEPTH_TEST);
+    m_renderTarget->Resolve();
+
+    // Reading into a pixel pack buffer returns immediately, the copy happens on the GPU.
+    const int slot = m_nFramesRead % e_pixelPackBufferCount;
+    m_bRgbRead[slot] = NeedsRgbFrame(m_nFramesRead);
+    m_bYuvRead[slot] = m_yuvConverter != NULL && NeedsYuvFrame(m_nFramesRead);
+    if (m_bRgbRead[slot])
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelPackBufferIds[slot]);
+        glReadPixels(0, 0, m_nWidth, m_nHeight, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+    if (m_bYuvRead[slot])
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_yuvPackBufferIds[slot]);
+        m_yuvConverter->Convert(m_nWidth, m_nHeight);
+    }
+    if (IsInstanceMaskFrame(m_nFramesRead))
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_instanceIdPackBufferIds[slot]);
+        m_renderTarget->ReadInstanceIds();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++m_nFramesRead;
     
-    if (writingToVideo()) {
-        videoFlush(m_PixelBuffer, width, height);
+    // Keep one buffer free for the next frame.
+    if (m_nFramesRead - m_nFramesResolved == e_pixelPackBufferCount)
+    {
+        ResolveFrame();
     }
 }
 
 void SimulationRenderer::Finish()
 {
-    if (writingToVideo()) {
-        deinit();
+    // Tiles are finished by their atlas.
+    if (m_pAtlas)
+        return;
+    
+    // The last frame is still in the framebuffer when it was only read back as YUV.
+    if (writingFrameImages() && m_nFramesRead > 0 && m_yuvConverter != NULL && !m_bRgbRead[(m_nFramesRead - 1) % e_pixelPackBufferCount])
+    {
+        glReadPixels(0, 0, m_nWidth, m_nHeight, GL_RGB, GL_UNSIGNED_BYTE, m_PixelBuffer);
+    }
+    
+    while (m_nFramesResolved < m_nFramesRead)
+    {
+        ResolveFrame();
+    }
+    
+    for (SimulationRenderer* tile : m_Tiles)
+    {
+        tile->CloseOutputs();
+    }
+    CloseOutputs();
+}
+
+void SimulationRenderer::CloseOutputs()
+{
+    for (VideoWriter* writer : m_VideoWriters)
+    {
+        writer->Close();
+    }
+    
+    if (writingToFrameArray()) {
+        m_pFrameArrayWriter->Close();
+    }
+    
+    // The ring drain above leaves the final frame in m_PixelBuffer.
+    if (writingFrameImages() && m_nFramesRead > 0) {
+        m_pImageWriter->Write(m_sFrameImageFolder + "last.png", m_PixelBuffer);
+    }
+    m_pImageWriter->Close();
+}
+
+void SimulationRenderer::CloseVideoOutputs()
+{
+    for (VideoWriter* writer : m_VideoWriters)
+    {
+        delete writer;
     }
+    m_VideoWriters.clear();
 }
 
 //Setters and getters
 void SimulationRenderer::setIsDebugMode(const bool &isDebug) {
     m_bIsDebugMode = isDebug;
+    if (m_pSoftwareRenderer)
+        m_pSoftwareRenderer->setIsDebugMode(isDebug);
 }
 
 bool SimulationRenderer::getIsDebugMode() const {
     return m_bIsDebugMode;
 }
 
-void SimulationRenderer::setFileOutput(const std::string& filePath, const int& width, const int& height)
+void SimulationRenderer::setFileOutput(const std::string& filePath, const int& width, const int& height, const VideoWriterOptions& videoOptions, const ImageWriterOptions& imageOptions)
 {
     m_sPath = filePath;
     m_nWidth = width;
@@ -1186,9 +2877,67 @@ void SimulationRenderer::setFileOutput(const std::string& filePath, const int& w
 
     m_PixelBuffer = (unsigned char*)malloc(sizeof(unsigned char) * 3 * width * height);
 
-    if (writingToVideo())
+    // The pixel pack buffers are sized for the output, recreate them if they already exist.
+    if (m_pixelPackBufferIds[0])
+    {
+        DestroyPixelPackBuffers();
+        CreatePixelPackBuffers();
+    }
+
+    CloseVideoOutputs();
+    delete m_pFrameArrayWriter;
+    m_pFrameArrayWriter = NULL;
+
+    // Screenshots and frame images are all encoded on the writer thread.
+    m_pImageWriter->Open(m_nWidth, m_nHeight, imageOptions);
+    m_sFrameImageFolder = "";
+    m_nFrameImageInterval = 0;
+    m_sInstanceMaskFolder = "";
+    m_nInstanceMaskInterval = 1;
+
+    if (m_sPath != "")
+    {
+        addVideoOutput(m_sPath, videoOptions);
+    }
+}
+
+void SimulationRenderer::addVideoOutput(const std::string& filePath, const VideoWriterOptions& videoOptions)
+{
+    VideoWriter* writer = new VideoWriter;
+    if (!writer->Open(filePath, m_nWidth, m_nHeight, videoOptions))
+    {
+        fprintf(stderr, "Could not open video output %s\n", filePath.c_str());
+        exit(1);
+    }
+    m_VideoWriters.push_back(writer);
+}
+
+void SimulationRenderer::setFrameImageOutput(const std::string& folderPath, const int& interval)
+{
+    m_sFrameImageFolder = folderPath;
+    if (m_sFrameImageFolder != "" && m_sFrameImageFolder.back() != '/') {
+        m_sFrameImageFolder += "/";
+    }
+    m_nFrameImageInterval = interval;
+}
+
+void SimulationRenderer::setInstanceMaskOutput(const std::string& folderPath, const int& interval)
+{
+    m_sInstanceMaskFolder = folderPath;
+    if (m_sInstanceMaskFolder != "" && m_sInstanceMaskFolder.back() != '/') {
+        m_sInstanceMaskFolder += "/";
+    }
+    m_nInstanceMaskInterval = interval > 0 ? interval : 1;
+}
+
+void SimulationRenderer::setFrameArrayOutput(const std::string& filePath, const int& fps, const float& sourceFps)
+{
+    delete m_pFrameArrayWriter;
+    m_pFrameArrayWriter = new FrameArrayWriter;
+    if (!m_pFrameArrayWriter->Open(filePath, m_nWidth, m_nHeight, fps, sourceFps))
     {
-        init(m_sPath, m_nWidth, m_nHeight);
+        fprintf(stderr, "Could not open frame array output %s\n", filePath.c_str());
+        exit(1);
     }
 }
 
@@ -11,6 +11,8 @@
 #include "SimulationDefines.h"
 #include "Box2D/Box2D.h"
 #include <string>
+#include <vector>
+#include <utility>
 
 #define RENDER_TEXTURES 1
 
@@ -18,6 +20,16 @@ struct b2AABB;
 struct GLRenderPoints;
 struct GLRenderLines;
 struct GLRenderTriangles;
+struct GLRenderMeshes;
+struct GLStaticLayer;
+struct GLRenderTarget;
+struct GLYuvConverter;
+class SoftwareRenderer;
+class VideoWriter;
+class FrameArrayWriter;
+class ImageWriter;
+struct VideoWriterOptions;
+struct ImageWriterOptions;
 
 // This class implements debug drawing callbacks that are invoked
 // inside b2World::Step.
@@ -30,6 +42,29 @@ public:
     void Create();
     void Destroy();
 
+    // Rasterises on the CPU instead, for runs without an OpenGL context. Frames go to the
+    // same outputs; anti-aliasing is not available.
+    void CreateSoftware();
+
+    // Applies the outputs another simulation set up to a renderer that was already created, so a
+    // batch of simulations shares the context, shaders and textures. Call it before the first frame.
+    void Reconfigure();
+
+    // Renders several simulations side by side, one tile each, into a columns x rows atlas frame
+    // that is read back at once and split up again into the outputs of each simulation. The
+    // simulations get their tile from AddTile and have to be created before Create.
+    void setAtlas(const int& columns, const int& rows);
+
+    bool isAtlas() const
+    {
+        return m_nAtlasColumns > 0;
+    }
+
+    // A renderer for the next tile of the atlas. It draws with the GL objects of the atlas into
+    // its part of the atlas frame, and has a static layer and outputs of its own. Begin a tile's
+    // frame after the atlas frame, Flush it before the atlas frame.
+    SimulationRenderer* AddTile();
+
     void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
 
     void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
@@ -48,6 +83,18 @@ public:
 
     void DrawTexturedRectangleChain(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width, uint32 glTexId, int matTexId) override;
 
+    uint32 CreateMesh(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, bool worldTextureCoordinates) override;
+
+    void DestroyMesh(uint32 meshId) override;
+
+    void DrawMesh(uint32 meshId, const b2Transform& xf, const b2Color& color, uint32 glTexId, int matTexId) override;
+
+    bool BeginStaticLayer(uint32 key) override;
+
+    void EndStaticLayer() override;
+
+    void SetInstanceId(uint32 id) override;
+
     void DrawTransform(const b2Transform& xf) override;
 
     void DrawPoint(const b2Vec2& p, float32 size, const b2Color& color) override;
@@ -58,7 +105,35 @@ public:
 
     void DrawAABB(b2AABB* aabb, const b2Color& color);
     
-    void setFileOutput(const std::string& filePath, const int& width, const int& height);
+    void setFileOutput(const std::string& filePath, const int& width, const int& height, const VideoWriterOptions& videoOptions, const ImageWriterOptions& imageOptions);
+
+    // Writes another video of the same frames, e.g. at a lower frame rate or size. Call after setFileOutput.
+    void addVideoOutput(const std::string& filePath, const VideoWriterOptions& videoOptions);
+
+    // Writes first.png, last.png and, when interval is positive, every interval-th frame
+    // into folderPath on a background thread. Call after setFileOutput.
+    void setFrameImageOutput(const std::string& folderPath, const int& interval);
+
+    // Writes mask_NNNNNN.png into folderPath every interval-th frame: 16-bit grayscale with the
+    // uniqueID + 1 of the body drawn at each pixel and 0 for the background. The ids are drawn
+    // in the same pass as the frame, into a second colour attachment. Call before Create.
+    void setInstanceMaskOutput(const std::string& folderPath, const int& interval);
+
+    // Also stores the frames, sampled at fps, as an (N, H, W, 3) uint8 .npy array. Call after setFileOutput.
+    void setFrameArrayOutput(const std::string& filePath, const int& fps, const float& sourceFps);
+
+    // Draws frames into an offscreen target with samples (0, 2, 4, 8 or 16) per pixel, at
+    // supersampling (1, 2 or 4) times the output size, resolved into the output framebuffer
+    // on Flush. The output framebuffer is drawn into directly for 0 samples and no supersampling.
+    void setAntiAliasing(const int& samples, const int& supersampling);
+
+    // Converts frames to YUV420P on the GPU and reads only that back for the videos encoded at
+    // the rendered size. RGB is still read for the frames other outputs need. Width and height
+    // must be even. Call before Create.
+    void setYuvReadback(const bool& enabled);
+
+    // Binds the frame's framebuffer, sets the viewport and clears it for a width x height output frame.
+    void BeginFrame(const int& width, const int& height);
 
     void Flush();
     
@@ -70,16 +145,62 @@ public:
     
     bool writingToVideo()
     {
-        //TODO: Check extension check
-        return m_sPath != "";
+        return !m_VideoWriters.empty();
+    }
+
+    bool writingToFrameArray()
+    {
+        return m_pFrameArrayWriter != NULL;
+    }
+
+    bool writingFrameImages()
+    {
+        return m_sFrameImageFolder != "";
+    }
+
+    bool writingInstanceMasks() const
+    {
+        return m_sInstanceMaskFolder != "";
     }
     
+    // Saves the frame of the latest Flush. Frames are read back asynchronously, so the
+    // image is queued on the writer thread once that frame leaves the pixel pack buffer ring.
     void SaveAsImage(std::string path);
     
 private:
+    enum { e_pixelPackBufferCount = 3 };
+
+    void CreateTile(SimulationRenderer* atlas, const int& x, const int& y);
+    void DeliverTiles(const unsigned char* pixels);
+    void CloseOutputs();
+    void CreatePixelPackBuffers();
+    void DestroyPixelPackBuffers();
+    void CloseVideoOutputs();
+    void ResolveFrame();
+    void DeliverFrame(const unsigned char* pixels, const unsigned char* yuv);
+    bool UsesYuvReadback(const VideoWriter* writer) const;
+    bool NeedsRgbFrame(const int& frame) const;
+    bool NeedsYuvFrame(const int& frame) const;
+    void DeliverInstanceMask(const unsigned short* ids);
+    bool IsInstanceMaskFrame(const int& frame) const;
+    void FlushBatches();
+
     GLRenderPoints* m_points;
     GLRenderLines* m_lines;
     GLRenderTriangles* m_triangles;
+    GLRenderMeshes* m_meshes;
+    GLStaticLayer* m_staticLayer;
+    GLRenderTarget* m_renderTarget;
+    GLYuvConverter* m_yuvConverter;
+    bool m_bYuvReadback;
+    SoftwareRenderer* m_pSoftwareRenderer;
+    std::vector<VideoWriter*> m_VideoWriters;
+    FrameArrayWriter* m_pFrameArrayWriter;
+    ImageWriter* m_pImageWriter;
+    std::string m_sFrameImageFolder;
+    int m_nFrameImageInterval;
+    std::string m_sInstanceMaskFolder;
+    int m_nInstanceMaskInterval;
     
     bool m_bIsDebugMode;
     std::string m_sPath;
@@ -87,11 +208,36 @@ private:
     int m_nHeight;
 
     unsigned char* m_PixelBuffer = NULL;
+
+    // Frame N is read into m_pixelPackBufferIds[N % e_pixelPackBufferCount] and
+    // mapped a few flushes later, once the GPU is done with it.
+    unsigned int m_pixelPackBufferIds[e_pixelPackBufferCount] = {};
+    unsigned int m_instanceIdPackBufferIds[e_pixelPackBufferCount] = {};
+    unsigned int m_yuvPackBufferIds[e_pixelPackBufferCount] = {};
+    bool m_bRgbRead[e_pixelPackBufferCount] = {};
+    bool m_bYuvRead[e_pixelPackBufferCount] = {};
+    int m_nFramesRead = 0;
+    int m_nFramesResolved = 0;
+    std::vector<std::pair<int, std::string>> m_PendingImages;
+
+    // Atlas: its tiles, which of them were drawn into each frame in flight, and a frame of one tile.
+    std::vector<SimulationRenderer*> m_Tiles;
+    std::vector<bool> m_TilesDrawn[e_pixelPackBufferCount];
+    std::vector<unsigned char> m_TilePixels;
+    int m_nAtlasColumns;
+    int m_nAtlasRows;
+
+    // Tile: the atlas it draws into and where.
+    SimulationRenderer* m_pAtlas;
+    int m_nTileIndex;
+    int m_nTileX;
+    int m_nTileY;
 };
 
 #if USE_DEBUG_DRAW
 #else
-extern SimulationRenderer g_debugDraw;
+// One per thread, so simulations on the threads of a pool each draw with their own renderer.
+extern thread_local SimulationRenderer g_debugDraw;
 #endif
 
 #endif /* SimulationRenderer_hpp */
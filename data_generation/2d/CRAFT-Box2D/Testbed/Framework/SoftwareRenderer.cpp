@@ -0,0 +1,705 @@
+//
+//  SoftwareRenderer.cpp
+//  Testbed
+//
+
+#include "SoftwareRenderer.hpp"
+#include "Box2D/Extension/b2VisDefines.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SOFTWARE_RENDERER_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Marks the pixels of a row span that lie inside every edge. edgeValues holds the edge
+// functions at the first pixel centre and edgeSteps their change per pixel. A pixel exactly
+// on an edge belongs to the polygon only when the edge owns it, so that polygons sharing an
+// edge never both cover a pixel.
+static void sCoverSpan(const float* edgeValues, const float* edgeSteps, const bool* ownsEdge, int32 edgeCount, int32 count, unsigned char* covered)
+{
+    for (int32 x = 0; x < count; ++x)
+    {
+        const float xf = float(x);
+        unsigned char inside = 1;
+        for (int32 i = 0; i < edgeCount; ++i)
+        {
+            const float value = edgeValues[i] + edgeSteps[i] * xf;
+            if (value < 0.0f || (value == 0.0f && !ownsEdge[i]))
+            {
+                inside = 0;
+                break;
+            }
+        }
+        covered[x] = inside;
+    }
+}
+
+#if SOFTWARE_RENDERER_AVX2
+// Same as sCoverSpan, 8 pixels at a time. The arithmetic is kept identical so both
+// versions cover the same pixels.
+__attribute__((target("avx2")))
+static void sCoverSpanAVX2(const float* edgeValues, const float* edgeSteps, const bool* ownsEdge, int32 edgeCount, int32 count, unsigned char* covered)
+{
+    const __m256 offsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (int32 x = 0; x < count; x += 8)
+    {
+        const __m256 xs = _mm256_add_ps(_mm256_set1_ps(float(x)), offsets);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int32 i = 0; i < edgeCount; ++i)
+        {
+            const __m256 value = _mm256_add_ps(_mm256_set1_ps(edgeValues[i]), _mm256_mul_ps(_mm256_set1_ps(edgeSteps[i]), xs));
+            const __m256 pass = ownsEdge[i] ? _mm256_cmp_ps(value, zero, _CMP_GE_OQ) : _mm256_cmp_ps(value, zero, _CMP_GT_OQ);
+            inside = _mm256_and_ps(inside, pass);
+        }
+
+        const int mask = _mm256_movemask_ps(inside);
+        const int32 n = b2Min(8, count - x);
+        for (int32 k = 0; k < n; ++k)
+        {
+            covered[x + k] = (unsigned char)((mask >> k) & 1);
+        }
+    }
+}
+#endif
+
+static unsigned char sToByte(float value)
+{
+    return (unsigned char)(b2Clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Loads a PNG as RGBA with the bottom row first, like b2VisTexture uploads it.
+static bool sLoadPng(const std::string& filePath, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+    FILE* fp = fopen(filePath.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        fclose(fp);
+        return false;
+    }
+
+    // libpng reports errors by jumping back here.
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png, fp);
+    png_read_png(png, info, PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING | PNG_TRANSFORM_EXPAND | PNG_TRANSFORM_GRAY_TO_RGB, nullptr);
+
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    const int channels = png_get_channels(png, info);
+    png_bytepp rows = png_get_rows(png, info);
+
+    rgba.resize(4 * width * height);
+    for (int i = 0; i < height; ++i)
+    {
+        const png_bytep row = rows[height - 1 - i];
+        unsigned char* out = rgba.data() + 4 * width * i;
+        for (int j = 0; j < width; ++j)
+        {
+            out[4 * j + 0] = row[channels * j + 0];
+            out[4 * j + 1] = row[channels * j + 1];
+            out[4 * j + 2] = row[channels * j + 2];
+            out[4 * j + 3] = channels == 4 ? row[channels * j + 3] : 255;
+        }
+    }
+
+    png_destroy_read_struct(&png, &info, nullptr);
+    fclose(fp);
+    return true;
+}
+
+SoftwareRenderer::SoftwareRenderer()
+{
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_nInstanceId = 0;
+    m_cameraCenter.Set(0.0f, 20.0f);
+    m_cameraZoom = 1.0f;
+    m_lower.SetZero();
+    m_pixelsPerUnit.SetZero();
+    m_clearColor = b2Color(1.0f, 1.0f, 1.0f);
+    m_bIsDebugMode = false;
+    m_bStaticLayerValid = false;
+    m_nStaticLayerKey = 0;
+    m_staticLayerCenter.SetZero();
+    m_staticLayerZoom = 0.0f;
+
+#if SOFTWARE_RENDERER_AVX2
+    m_bUseAVX2 = __builtin_cpu_supports("avx2");
+#else
+    m_bUseAVX2 = false;
+#endif
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+}
+
+void SoftwareRenderer::Resize(const int& width, const int& height)
+{
+    m_nWidth = width;
+    m_nHeight = height;
+    m_Pixels.assign(3 * width * height, 0);
+    m_Depth.assign(width * height, e_clearDepth);
+    m_InstanceIds.assign(width * height, 0);
+    m_Covered.resize(width + 8);
+    m_bStaticLayerValid = false;
+    setCamera(m_cameraCenter, m_cameraZoom);
+}
+
+void SoftwareRenderer::setCamera(const b2Vec2& center, const float32& zoom)
+{
+    m_cameraCenter = center;
+    m_cameraZoom = zoom;
+
+    const float32 ratio = m_nHeight > 0 ? float32(m_nWidth) / float32(m_nHeight) : 1.0f;
+    b2Vec2 extents(ratio * 25.0f, 25.0f);
+    extents *= zoom;
+
+    m_lower = center - extents;
+    m_pixelsPerUnit.Set(m_nWidth / (2.0f * extents.x), m_nHeight / (2.0f * extents.y));
+}
+
+void SoftwareRenderer::setClearColor(const b2Color& color)
+{
+    m_clearColor = color;
+}
+
+bool SoftwareRenderer::setMaterialImage(const int& materialIndex, const std::string& filePath)
+{
+    if (materialIndex < 0)
+        return false;
+
+    if ((int)m_MaterialImages.size() <= materialIndex)
+        m_MaterialImages.resize(materialIndex + 1);
+
+    Image& image = m_MaterialImages[materialIndex];
+    if (!sLoadPng(filePath, image.width, image.height, image.rgba)) {
+        fprintf(stderr, "Could not load %s\n", filePath.c_str());
+        image = Image();
+        return false;
+    }
+    return true;
+}
+
+void SoftwareRenderer::setIsDebugMode(const bool& isDebug)
+{
+    m_bIsDebugMode = isDebug;
+}
+
+void SoftwareRenderer::Clear()
+{
+    const unsigned char clear[3] = { sToByte(m_clearColor.r), sToByte(m_clearColor.g), sToByte(m_clearColor.b) };
+    for (int i = 0; i < m_nWidth * m_nHeight; ++i)
+    {
+        memcpy(m_Pixels.data() + 3 * i, clear, 3);
+    }
+    memset(m_Depth.data(), e_clearDepth, m_Depth.size());
+    memset(m_InstanceIds.data(), 0, m_InstanceIds.size() * sizeof(unsigned short));
+}
+
+b2Vec2 SoftwareRenderer::ToPixel(const b2Vec2& p) const
+{
+    return b2Vec2((p.x - m_lower.x) * m_pixelsPerUnit.x, (p.y - m_lower.y) * m_pixelsPerUnit.y);
+}
+
+// Bilinear and repeating, like the GL_LINEAR / GL_REPEAT material textures.
+void SoftwareRenderer::Sample(const Image& image, float u, float v, float* rgba) const
+{
+    const float x = u * image.width - 0.5f;
+    const float y = v * image.height - 0.5f;
+    const float x0 = floorf(x);
+    const float y0 = floorf(y);
+    const float fx = x - x0;
+    const float fy = y - y0;
+
+    int ix[2] = { (int)x0 % image.width, ((int)x0 + 1) % image.width };
+    int iy[2] = { (int)y0 % image.height, ((int)y0 + 1) % image.height };
+    for (int k = 0; k < 2; ++k)
+    {
+        if (ix[k] < 0) ix[k] += image.width;
+        if (iy[k] < 0) iy[k] += image.height;
+    }
+
+    const unsigned char* t00 = image.rgba.data() + 4 * (iy[0] * image.width + ix[0]);
+    const unsigned char* t10 = image.rgba.data() + 4 * (iy[0] * image.width + ix[1]);
+    const unsigned char* t01 = image.rgba.data() + 4 * (iy[1] * image.width + ix[0]);
+    const unsigned char* t11 = image.rgba.data() + 4 * (iy[1] * image.width + ix[1]);
+    for (int c = 0; c < 4; ++c)
+    {
+        const float bottom = t00[c] + fx * (t10[c] - t00[c]);
+        const float top = t01[c] + fx * (t11[c] - t01[c]);
+        rgba[c] = (bottom + fy * (top - bottom)) / 255.0f;
+    }
+}
+
+// Covers the triangle fan GL draws for a polygon. Convex polygons are covered in one pass,
+// which is the same as covering their fan since no pixel lies in two of its triangles.
+void SoftwareRenderer::FillPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color, const b2Vec2* textureCoordinates, int matTexId)
+{
+    bool isConvex = vertexCount <= e_maxPolygonVertices;
+    float32 winding = 0.0f;
+    for (int32 i = 0; i < vertexCount && isConvex; ++i)
+    {
+        const b2Vec2 e1 = vertices[(i + 1) % vertexCount] - vertices[i];
+        const b2Vec2 e2 = vertices[(i + 2) % vertexCount] - vertices[(i + 1) % vertexCount];
+        const float32 turn = b2Cross(e1, e2);
+        if (turn * winding < 0.0f)
+            isConvex = false;
+        else if (turn != 0.0f)
+            winding = turn;
+    }
+
+    if (isConvex)
+    {
+        FillConvexPolygon(vertices, vertexCount, color, textureCoordinates, matTexId);
+        return;
+    }
+
+    for (int32 i = 1; i < vertexCount - 1; ++i)
+    {
+        const b2Vec2 triangle[3] = { vertices[0], vertices[i], vertices[i + 1] };
+        if (textureCoordinates)
+        {
+            const b2Vec2 triangleTexCoords[3] = { textureCoordinates[0], textureCoordinates[i], textureCoordinates[i + 1] };
+            FillConvexPolygon(triangle, 3, color, triangleTexCoords, matTexId);
+        }
+        else
+        {
+            FillConvexPolygon(triangle, 3, color, NULL, matTexId);
+        }
+    }
+}
+
+// Covers a convex polygon, given in either winding, and blends it into the frame. Texture
+// coordinates are interpolated affinely across the polygon, which matches the triangle fan
+// GL draws as long as they are an affine function of the position, as for every body.
+void SoftwareRenderer::FillConvexPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color, const b2Vec2* textureCoordinates, int matTexId)
+{
+    b2Assert(vertexCount <= e_maxPolygonVertices);
+    if (vertexCount < 3 || m_nWidth == 0 || m_nHeight == 0)
+        return;
+
+    b2Vec2 points[e_maxPolygonVertices];
+    float32 area = 0.0f;
+    b2Vec2 lower(FLT_MAX, FLT_MAX);
+    b2Vec2 upper(-FLT_MAX, -FLT_MAX);
+    for (int32 i = 0; i < vertexCount; ++i)
+    {
+        points[i] = ToPixel(vertices[i]);
+        lower = b2Min(lower, points[i]);
+        upper = b2Max(upper, points[i]);
+    }
+    for (int32 i = 0; i < vertexCount; ++i)
+    {
+        area += b2Cross(points[i], points[(i + 1) % vertexCount]);
+    }
+    if (area == 0.0f)
+        return;
+    const float32 winding = area > 0.0f ? 1.0f : -1.0f;
+
+    // value = a * x + b * y + c is positive inside the polygon.
+    float32 a[e_maxPolygonVertices];
+    float32 b[e_maxPolygonVertices];
+    float32 c[e_maxPolygonVertices];
+    bool ownsEdge[e_maxPolygonVertices];
+    for (int32 i = 0; i < vertexCount; ++i)
+    {
+        const b2Vec2& p1 = points[i];
+        const b2Vec2& p2 = points[(i + 1) % vertexCount];
+        a[i] = -winding * (p2.y - p1.y);
+        b[i] = winding * (p2.x - p1.x);
+        c[i] = -(a[i] * p1.x + b[i] * p1.y);
+        ownsEdge[i] = a[i] > 0.0f || (a[i] == 0.0f && b[i] < 0.0f);
+    }
+
+    const Image* image = NULL;
+    if (textureCoordinates && matTexId >= 0 && matTexId < (int)m_MaterialImages.size() && !m_MaterialImages[matTexId].rgba.empty())
+        image = &m_MaterialImages[matTexId];
+
+    // Texture coordinates as a function of the pixel position, from the largest fan triangle. The
+    // first ones of a polygon with many vertices are slivers that would make the gradients imprecise.
+    b2Vec2 texOrigin(0.0f, 0.0f), texDx(0.0f, 0.0f), texDy(0.0f, 0.0f);
+    if (image)
+    {
+        int32 largest = 0;
+        float32 largestDet = 0.0f;
+        for (int32 i = 1; i < vertexCount - 1; ++i)
+        {
+            const float32 det = b2Cross(points[i] - points[0], points[i + 1] - points[0]);
+            if (fabsf(det) > fabsf(largestDet))
+            {
+                largest = i;
+                largestDet = det;
+            }
+        }
+
+        if (fabsf(largestDet) < 1e-6f)
+        {
+            image = NULL;
+        }
+        else
+        {
+            const b2Vec2 e1 = points[largest] - points[0];
+            const b2Vec2 e2 = points[largest + 1] - points[0];
+            const b2Vec2 t1 = textureCoordinates[largest] - textureCoordinates[0];
+            const b2Vec2 t2 = textureCoordinates[largest + 1] - textureCoordinates[0];
+            texDx = (1.0f / largestDet) * (e2.y * t1 - e1.y * t2);
+            texDy = (1.0f / largestDet) * (e1.x * t2 - e2.x * t1);
+            texOrigin = textureCoordinates[0] - points[0].x * texDx - points[0].y * texDy;
+        }
+    }
+
+    const int32 x0 = b2Max(0, (int32)floorf(lower.x));
+    const int32 x1 = b2Min(m_nWidth, (int32)ceilf(upper.x) + 1);
+    const int32 y0 = b2Max(0, (int32)floorf(lower.y));
+    const int32 y1 = b2Min(m_nHeight, (int32)ceilf(upper.y) + 1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const float src[4] = { color.r, color.g, color.b, color.a };
+    float edgeValues[e_maxPolygonVertices];
+    for (int32 y = y0; y < y1; ++y)
+    {
+        const float32 yc = y + 0.5f;
+        const float32 xc = x0 + 0.5f;
+        for (int32 i = 0; i < vertexCount; ++i)
+        {
+            edgeValues[i] = a[i] * xc + b[i] * yc + c[i];
+        }
+
+#if SOFTWARE_RENDERER_AVX2
+        if (m_bUseAVX2)
+            sCoverSpanAVX2(edgeValues, a, ownsEdge, vertexCount, x1 - x0, m_Covered.data());
+        else
+#endif
+            sCoverSpan(edgeValues, a, ownsEdge, vertexCount, x1 - x0, m_Covered.data());
+
+        for (int32 x = x0; x < x1; ++x)
+        {
+            const int32 index = y * m_nWidth + x;
+            if (!m_Covered[x - x0] || m_Depth[index] <= e_triangleDepth)
+                continue;
+            m_Depth[index] = e_triangleDepth;
+            m_InstanceIds[index] = m_nInstanceId;
+
+            const float* fragment = src;
+            float texel[4];
+            if (image)
+            {
+                const b2Vec2 uv = texOrigin + (x + 0.5f) * texDx + yc * texDy;
+                Sample(*image, uv.x, uv.y, texel);
+
+                // Chroma key green is replaced by the body colour.
+                if (!(texel[0] <= 0.05f && texel[1] >= 0.95f && texel[2] <= 0.05f))
+                    fragment = texel;
+            }
+
+            unsigned char* pixel = m_Pixels.data() + 3 * index;
+            const float alpha = fragment[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                pixel[k] = sToByte(fragment[k] * alpha + (pixel[k] / 255.0f) * (1.0f - alpha));
+            }
+        }
+    }
+}
+
+// One pixel wide, stepping along the major axis through the pixel centres.
+void SoftwareRenderer::FillLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
+{
+    const b2Vec2 a = ToPixel(p1);
+    const b2Vec2 b = ToPixel(p2);
+    const b2Vec2 d = b - a;
+    const bool xMajor = fabsf(d.x) >= fabsf(d.y);
+    const float32 length = xMajor ? d.x : d.y;
+    if (length == 0.0f)
+        return;
+
+    const unsigned char rgb[3] = { sToByte(color.r), sToByte(color.g), sToByte(color.b) };
+    const float32 start = xMajor ? b2Min(a.x, b.x) : b2Min(a.y, b.y);
+    const float32 end = xMajor ? b2Max(a.x, b.x) : b2Max(a.y, b.y);
+    for (int32 i = (int32)floorf(start + 0.5f); i < (int32)floorf(end + 0.5f); ++i)
+    {
+        const float32 t = ((i + 0.5f) - (xMajor ? a.x : a.y)) / length;
+        const float32 minor = xMajor ? a.y + t * d.y : a.x + t * d.x;
+        const int32 x = xMajor ? i : (int32)floorf(minor);
+        const int32 y = xMajor ? (int32)floorf(minor) : i;
+        if (x < 0 || x >= m_nWidth || y < 0 || y >= m_nHeight)
+            continue;
+
+        const int32 index = y * m_nWidth + x;
+        if (m_Depth[index] <= e_lineDepth)
+            continue;
+        m_Depth[index] = e_lineDepth;
+        m_InstanceIds[index] = m_nInstanceId;
+        memcpy(m_Pixels.data() + 3 * index, rgb, 3);
+    }
+}
+
+// A size x size pixel square, like gl_PointSize.
+void SoftwareRenderer::FillPoint(const b2Vec2& p, float32 size, const b2Color& color)
+{
+    const b2Vec2 center = ToPixel(p);
+    const unsigned char rgb[3] = { sToByte(color.r), sToByte(color.g), sToByte(color.b) };
+    const int32 x0 = b2Max(0, (int32)floorf(center.x - 0.5f * size + 0.5f));
+    const int32 x1 = b2Min(m_nWidth, (int32)floorf(center.x + 0.5f * size + 0.5f));
+    const int32 y0 = b2Max(0, (int32)floorf(center.y - 0.5f * size + 0.5f));
+    const int32 y1 = b2Min(m_nHeight, (int32)floorf(center.y + 0.5f * size + 0.5f));
+    for (int32 y = y0; y < y1; ++y)
+    {
+        for (int32 x = x0; x < x1; ++x)
+        {
+            const int32 index = y * m_nWidth + x;
+            if (m_Depth[index] <= e_pointDepth)
+                continue;
+            m_Depth[index] = e_pointDepth;
+            m_InstanceIds[index] = m_nInstanceId;
+            memcpy(m_Pixels.data() + 3 * index, rgb, 3);
+        }
+    }
+}
+
+//
+void SoftwareRenderer::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+    b2Vec2 p1 = vertices[vertexCount - 1];
+    for (int32 i = 0; i < vertexCount; ++i)
+    {
+        b2Vec2 p2 = vertices[i];
+        FillLine(p1, p2, color);
+        p1 = p2;
+    }
+}
+
+void SoftwareRenderer::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+    const float transConst = m_bIsDebugMode ? 0.5 : 1.0;
+    b2Color fillColor(transConst * color.r, transConst * color.g, transConst * color.b, transConst);
+
+    FillPolygon(vertices, vertexCount, fillColor, NULL, -1);
+
+    if (m_bIsDebugMode)
+        DrawPolygon(vertices, vertexCount, color);
+}
+
+void SoftwareRenderer::DrawTexturedPolygon(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, const b2Color& color, uint32 glTexId, int matTexId)
+{
+    B2_NOT_USED(glTexId);
+    const float transConst = m_bIsDebugMode ? 0.5 : 1.0;
+    b2Color fillColor(transConst * color.r, transConst * color.g, transConst * color.b, transConst);
+
+    FillPolygon(vertices, vertexCount, fillColor, textureCoordinates, matTexId);
+
+    if (m_bIsDebugMode)
+        DrawPolygon(vertices, vertexCount, color);
+}
+
+//
+void SoftwareRenderer::DrawCircle(const b2Vec2& center, float32 radius, const b2Color& color)
+{
+    const float32 k_segments = 16.0f;
+    const float32 k_increment = 2.0f * b2_pi / k_segments;
+    float32 sinInc = sinf(k_increment);
+    float32 cosInc = cosf(k_increment);
+    b2Vec2 r1(1.0f, 0.0f);
+    b2Vec2 v1 = center + radius * r1;
+    for (int32 i = 0; i < k_segments; ++i)
+    {
+        // Perform rotation to avoid additional trigonometry.
+        b2Vec2 r2;
+        r2.x = cosInc * r1.x - sinInc * r1.y;
+        r2.y = sinInc * r1.x + cosInc * r1.y;
+        b2Vec2 v2 = center + radius * r2;
+        FillLine(v1, v2, color);
+        r1 = r2;
+        v1 = v2;
+    }
+}
+
+void SoftwareRenderer::DrawSolidCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color)
+{
+    const float32 k_segments = 16.0f;
+    const float32 k_increment = 2.0f * b2_pi / k_segments;
+    float32 sinInc = sinf(k_increment);
+    float32 cosInc = cosf(k_increment);
+    b2Vec2 r1(cosInc, sinInc);
+    b2Vec2 vertices[e_maxPolygonVertices];
+    for (int32 i = 0; i < k_segments; ++i)
+    {
+        // The rim of the triangle fan GL draws.
+        b2Vec2 r2;
+        r2.x = cosInc * r1.x - sinInc * r1.y;
+        r2.y = sinInc * r1.x + cosInc * r1.y;
+        vertices[i] = center + radius * r1;
+        r1 = r2;
+    }
+    FillPolygon(vertices, (int32)k_segments, b2Color(color.r, color.g, color.b, 1.0f), NULL, -1);
+
+    if (m_bIsDebugMode)
+    {
+        DrawCircle(center, radius, color);
+
+        // Draw a line fixed in the circle to animate rotation.
+        FillLine(center, center + radius * axis, color);
+    }
+}
+
+void SoftwareRenderer::DrawTexturedCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color, uint32 glTexId, int matTexId)
+{
+    B2_NOT_USED(axis);
+    B2_NOT_USED(glTexId);
+    const float32 k_segments = 16.0f;
+    const float32 k_increment = 2.0f * b2_pi / k_segments;
+    float32 sinInc = sinf(k_increment);
+    float32 cosInc = cosf(k_increment);
+    b2Vec2 r1(cosInc, sinInc);
+    b2Vec2 vertices[e_maxPolygonVertices];
+    b2Vec2 texCoords[e_maxPolygonVertices];
+    for (int32 i = 0; i < k_segments; ++i)
+    {
+        b2Vec2 r2;
+        r2.x = cosInc * r1.x - sinInc * r1.y;
+        r2.y = sinInc * r1.x + cosInc * r1.y;
+        vertices[i] = center + radius * r1;
+        texCoords[i] = b2Vec2(vertices[i].x / TEXTURE_SQUARE_EDGE_LENGTH, vertices[i].y / TEXTURE_SQUARE_EDGE_LENGTH);
+        r1 = r2;
+    }
+    b2Color fillColor(0.5f * color.r, 0.5f * color.g, 0.5f * color.b, 0.5f);
+    FillPolygon(vertices, (int32)k_segments, fillColor, texCoords, matTexId);
+
+    DrawCircle(center, radius, color);
+}
+
+//
+void SoftwareRenderer::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
+{
+    FillLine(p1, p2, color);
+}
+
+// The rectangle of width around the chain segment p1-p2, in the vertex order of SimulationRenderer.
+static void sChainRectangle(const b2Vec2& p1, const b2Vec2& p2, float width, b2Vec2* vertices)
+{
+    b2Vec2 d = p2 - p1;
+    d.Normalize();
+    const b2Vec2 perpendicular = 0.5f * width * b2Vec2(-d.y, d.x);
+
+    vertices[0] = p1 + perpendicular;
+    vertices[1] = p2 + perpendicular;
+    vertices[2] = p2 - perpendicular;
+    vertices[3] = p1 - perpendicular;
+}
+
+void SoftwareRenderer::DrawRectangleChain(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width)
+{
+    b2Vec2 vertices[4];
+    sChainRectangle(p1, p2, width, vertices);
+    DrawSolidPolygon(vertices, 4, color);
+}
+
+void SoftwareRenderer::DrawTexturedRectangleChain(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width, uint32 glTexId, int matTexId)
+{
+    b2Vec2 vertices[4];
+    b2Vec2 texCoords[4];
+    sChainRectangle(p1, p2, width, vertices);
+    for (int32 i = 0; i < 4; ++i)
+    {
+        texCoords[i] = b2Vec2(vertices[i].x / TEXTURE_SQUARE_EDGE_LENGTH, vertices[i].y / TEXTURE_SQUARE_EDGE_LENGTH);
+    }
+    DrawTexturedPolygon(vertices, texCoords, 4, color, glTexId, matTexId);
+}
+
+void SoftwareRenderer::InvalidateStaticLayer()
+{
+    m_bStaticLayerValid = false;
+}
+
+// Called right after Clear, so the frame holds only the static bodies until EndStaticLayer.
+bool SoftwareRenderer::BeginStaticLayer(uint32 key)
+{
+    if (m_bStaticLayerValid
+        && m_nStaticLayerKey == key
+        && m_staticLayerCenter == m_cameraCenter
+        && m_staticLayerZoom == m_cameraZoom)
+    {
+        m_Pixels = m_StaticLayerPixels;
+        m_InstanceIds = m_StaticLayerInstanceIds;
+        return false;
+    }
+
+    m_nStaticLayerKey = key;
+    m_staticLayerCenter = m_cameraCenter;
+    m_staticLayerZoom = m_cameraZoom;
+    return true;
+}
+
+// Like the GL layer, only colour and instance ids are kept: dynamic bodies are drawn over the static ones.
+void SoftwareRenderer::EndStaticLayer()
+{
+    m_StaticLayerPixels = m_Pixels;
+    m_StaticLayerInstanceIds = m_InstanceIds;
+    m_bStaticLayerValid = true;
+    memset(m_Depth.data(), e_clearDepth, m_Depth.size());
+}
+
+void SoftwareRenderer::SetInstanceId(uint32 id)
+{
+    m_nInstanceId = (unsigned short)id;
+}
+
+//
+void SoftwareRenderer::DrawTransform(const b2Transform& xf)
+{
+    const float32 k_axisScale = 0.4f;
+    b2Color red(1.0f, 0.0f, 0.0f);
+    b2Color green(0.0f, 1.0f, 0.0f);
+    b2Vec2 p1 = xf.p;
+
+    FillLine(p1, p1 + k_axisScale * xf.q.GetXAxis(), red);
+    FillLine(p1, p1 + k_axisScale * xf.q.GetYAxis(), green);
+}
+
+//
+void SoftwareRenderer::DrawPoint(const b2Vec2& p, float32 size, const b2Color& color)
+{
+    FillPoint(p, size, color);
+}
+
+void SoftwareRenderer::Flush()
+{
+}
+
+const unsigned char* SoftwareRenderer::getPixels() const
+{
+    return m_Pixels.data();
+}
+
+const unsigned short* SoftwareRenderer::getInstanceIds() const
+{
+    return m_InstanceIds.data();
+}
+
+int SoftwareRenderer::getWidth() const
+{
+    return m_nWidth;
+}
+
+int SoftwareRenderer::getHeight() const
+{
+    return m_nHeight;
+}
@@ -0,0 +1,139 @@
+//
+//  SoftwareRenderer.hpp
+//  Testbed
+//
+
+#ifndef SoftwareRenderer_hpp
+#define SoftwareRenderer_hpp
+
+#include "Box2D/Box2D.h"
+#include <string>
+#include <vector>
+
+// Rasterises the draw callbacks on the CPU into an RGB frame, with the same output as
+// SimulationRenderer: textured bodies are sampled bilinearly with the chroma key of the
+// material shader, triangles are blended, and the depth rules of the GL batches decide
+// overlaps (the first triangle drawn into a pixel wins, lines and points are drawn on top).
+// It needs no OpenGL context and keeps all of its state in the instance, so simulations
+// can render in parallel on separate instances. Convex polygons are covered with edge
+// functions, evaluated for 8 pixels at once with AVX2 when the CPU supports it.
+class SoftwareRenderer : public b2Draw
+{
+public:
+    SoftwareRenderer();
+    virtual ~SoftwareRenderer();
+
+    // Sizes the frame. Rows are stored bottom-up, like glReadPixels returns them.
+    void Resize(const int& width, const int& height);
+
+    // The view of Camera::BuildProjectionMatrix for this frame size.
+    void setCamera(const b2Vec2& center, const float32& zoom);
+
+    void setClearColor(const b2Color& color);
+
+    // Image sampled for bodies of materialIndex. Materials without an image are drawn in the body colour.
+    bool setMaterialImage(const int& materialIndex, const std::string& filePath);
+
+    void setIsDebugMode(const bool& isDebug);
+
+    // Clears colour and depth for the next frame.
+    void Clear();
+
+    // Drops the cached static bodies, whose key may repeat in the next world drawn.
+    void InvalidateStaticLayer();
+
+    void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
+
+    void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
+
+    void DrawTexturedPolygon(const b2Vec2* vertices, const b2Vec2* textureCoordinates, int32 vertexCount, const b2Color& color, uint32 glTexId, int matTexId) override;
+
+    void DrawCircle(const b2Vec2& center, float32 radius, const b2Color& color) override;
+
+    void DrawSolidCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color) override;
+
+    void DrawTexturedCircle(const b2Vec2& center, float32 radius, const b2Vec2& axis, const b2Color& color, uint32 glTexId, int matTexId) override;
+
+    void DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color) override;
+
+    void DrawRectangleChain(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width) override;
+
+    void DrawTexturedRectangleChain(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width, uint32 glTexId, int matTexId) override;
+
+    bool BeginStaticLayer(uint32 key) override;
+
+    void EndStaticLayer() override;
+
+    void SetInstanceId(uint32 id) override;
+
+    void DrawTransform(const b2Transform& xf) override;
+
+    void DrawPoint(const b2Vec2& p, float32 size, const b2Color& color) override;
+
+    // Draws are rasterised right away, the frame is complete once the last one returns.
+    void Flush();
+
+    // width * height * 3 bytes, bottom row first.
+    const unsigned char* getPixels() const;
+
+    // width * height instance ids of the frame, bottom row first, 0 where no body was drawn.
+    const unsigned short* getInstanceIds() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    // Depth of the GL batches: a draw only covers pixels whose stored depth is larger.
+    enum
+    {
+        e_pointDepth = 0,
+        e_lineDepth = 1,
+        e_triangleDepth = 2,
+        e_clearDepth = 3,
+    };
+
+    // Any b2PolygonShape, like the 128-gon circles of the scenes, is covered in one pass when convex.
+    enum { e_maxPolygonVertices = b2_maxPolygonVertices };
+
+    struct Image
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> rgba; // bottom row first, like the GL texture
+    };
+
+    b2Vec2 ToPixel(const b2Vec2& p) const;
+    void FillPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color, const b2Vec2* textureCoordinates, int matTexId);
+    void FillConvexPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color, const b2Vec2* textureCoordinates, int matTexId);
+    void FillLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color);
+    void FillPoint(const b2Vec2& p, float32 size, const b2Color& color);
+    void Sample(const Image& image, float u, float v, float* rgba) const;
+
+    int m_nWidth;
+    int m_nHeight;
+    std::vector<unsigned char> m_Pixels;
+    std::vector<unsigned char> m_Depth;
+    std::vector<unsigned short> m_InstanceIds;
+    unsigned short m_nInstanceId;
+    std::vector<unsigned char> m_Covered;
+
+    b2Vec2 m_cameraCenter;
+    float32 m_cameraZoom;
+    b2Vec2 m_lower;
+    b2Vec2 m_pixelsPerUnit;
+    b2Color m_clearColor;
+
+    std::vector<Image> m_MaterialImages;
+    bool m_bIsDebugMode;
+    bool m_bUseAVX2;
+
+    // Colour of the static bodies, copied into the following frames while the key is unchanged.
+    std::vector<unsigned char> m_StaticLayerPixels;
+    std::vector<unsigned short> m_StaticLayerInstanceIds;
+    bool m_bStaticLayerValid;
+    uint32 m_nStaticLayerKey;
+    b2Vec2 m_staticLayerCenter;
+    float32 m_staticLayerZoom;
+};
+
+#endif /* SoftwareRenderer_hpp */
@@ -0,0 +1,324 @@
+//
+//  VariationRunner.h
+//  Testbed
+//
+
+#ifndef VariationRunner_h
+#define VariationRunner_h
+
+#include "ControllerParser.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace svqa {
+    // Counterfactual variations of a simulation that has already run: for every dynamic object of
+    // its start scene, the simulation is run again without that object, physics only. The outputs
+    // and the events each object enables and prevents are written into one variations JSON, like
+    // VariationRunner in question_generation/framework/simulation.py does with one Testbed
+    // process per object. Variations whose object touches nothing for a while resume from an in-memory
+    // checkpoint instead of the start scene, see checkpointInterval in Settings.
+    class VariationRunner
+    {
+    public:
+        // Reads the original output from the outputJSONPath of the controller.
+        static int run(const std::string& controllerPath, const std::string& variationsOutputPath, const int& threadCount)
+        {
+            json controller;
+            json original;
+            if (!JSONHelper::loadJSON(controller, controllerPath)
+                || !JSONHelper::loadJSON(original, controller.at("outputJSONPath").get<std::string>()))
+            {
+                fprintf(stderr, "Could not load the controller %s or its output\n", controllerPath.c_str());
+                return -1;
+            }
+
+            json startScene;
+            for (const auto& sceneState : original.at("scene_states"))
+            {
+                if (sceneState.at("step").get<int>() == 0)
+                {
+                    startScene = sceneState.at("scene");
+                    break;
+                }
+            }
+            if (startScene.is_null())
+            {
+                fprintf(stderr, "The output of %s has no start scene\n", controllerPath.c_str());
+                return -1;
+            }
+
+            // Variations only need the causal graph and the scene states, so they run without rendering.
+            json variationController = controller;
+            variationController["offline"] = true;
+            variationController["renderBackend"] = "none";
+            variationController["inputScenePath"] = "";
+            variationController["outputVideoPath"] = "";
+            variationController["outputJSONPath"] = "";
+            variationController["additionalVideoOutputs"] = json::array();
+            variationController["frameArrayOutputPath"] = "";
+            variationController["frameImageOutputFolder"] = "";
+            variationController["instanceMaskOutputFolder"] = "";
+            variationController["screenshotOutputFolder"] = "";
+            variationController["snapshotOutputFolder"] = "";
+            variationController["gpuYuvConversion"] = false;
+
+            const json& objects = startScene.at("objects");
+            std::vector<int> removedObjects;
+            for (int i = 0; i < (int)objects.size(); ++i)
+            {
+                if (objects[i].at("bodyType").get<int>() != b2_staticBody)
+                    removedObjects.push_back(i);
+            }
+
+            SimulationMaterial::setTextureLoadingEnabled(false);
+
+            // The controller is checked here once, exceptions cannot leave the worker threads below.
+            SimulationBase::Ptr simulation;
+            try
+            {
+                simulation = parse(variationController);
+            }
+            catch (const char* error)
+            {
+                fprintf(stderr, "%s: %s\n", controllerPath.c_str(), error);
+                return -1;
+            }
+            catch (const std::exception& error)
+            {
+                fprintf(stderr, "%s: %s\n", controllerPath.c_str(), error.what());
+                return -1;
+            }
+            if (!simulation)
+            {
+                fprintf(stderr, "Unknown simulationID in the controller %s\n", controllerPath.c_str());
+                return -1;
+            }
+
+            // Removing an object changes nothing before it first touches another one, so a variation can
+            // start from the last checkpoint before the earliest event of its object in the original. The
+            // checkpoints come from running the start scene again up to the last one needed.
+            std::vector<SimulationBase::Checkpoint::Ptr> checkpoints;
+            std::vector<int> firstSteps(removedObjects.size());
+            if (removedObjects.size() > 1)
+            {
+                const Settings::Ptr& settings = simulation->getSettings();
+
+                // Contacts still waiting for their event when the simulation ends leave none, they started
+                // COLLISION_DETECTION_STEP_DIFF + 1 steps before the end at the earliest.
+                const int lastSafeStep = settings->stepCount - COLLISION_DETECTION_STEP_DIFF - 1;
+                int lastStep = 0;
+                for (size_t i = 0; i < removedObjects.size(); ++i)
+                {
+                    const int removedId = objects[removedObjects[i]].at("uniqueID").get<int>();
+                    firstSteps[i] = std::min(getFirstEventStep(original.at("causal_graph"), removedId), lastSafeStep);
+                    lastStep = std::max(lastStep, firstSteps[i]);
+                }
+
+                // The first simulation steps once to load the scene, there is no checkpoint before that.
+                const int interval = settings->checkpointInterval;
+                if (interval > 0 && lastStep >= interval)
+                    runReference(simulation, startScene, lastStep - lastStep % interval, checkpoints);
+            }
+            simulation.reset();
+
+            // The rerun can drift from the original, checkpoints after an event of the object in the rerun are skipped.
+            std::vector<SimulationBase::Checkpoint::Ptr> variationCheckpoints(removedObjects.size());
+            for (size_t i = 0; i < removedObjects.size(); ++i)
+            {
+                const int removedId = objects[removedObjects[i]].at("uniqueID").get<int>();
+                for (const auto& checkpoint : checkpoints)
+                {
+                    if (checkpoint->step > firstSteps[i] || checkpoint->hasTouched(removedId))
+                        break;
+                    variationCheckpoints[i] = checkpoint;
+                }
+            }
+
+            // Each variation is independent, they are spread over the threads like a pool.
+            std::vector<json> outputs(removedObjects.size());
+            std::atomic<int> next(0);
+            std::atomic<int> failed(0);
+            auto worker = [&]()
+            {
+                for (int i = next++; i < (int)removedObjects.size(); i = next++)
+                {
+                    const int removedId = objects[removedObjects[i]].at("uniqueID").get<int>();
+                    json scene;
+                    if (!variationCheckpoints[i])
+                    {
+                        scene = startScene;
+                        scene["objects"].erase(scene["objects"].begin() + removedObjects[i]);
+                    }
+                    if (!runVariation(variationController, scene, variationCheckpoints[i].get(), removedId, outputs[i]))
+                        ++failed;
+                }
+            };
+            std::vector<std::thread> workers;
+            for (int i = 1; i < threadCount; ++i)
+            {
+                workers.emplace_back(worker);
+            }
+            worker();
+            for (std::thread& thread : workers)
+            {
+                thread.join();
+            }
+            if (failed > 0)
+                return -1;
+
+            json variationsOutput = json::object();
+            json enables = json::array();
+            json prevents = json::array();
+            for (size_t i = 0; i < removedObjects.size(); ++i)
+            {
+                const int removedId = objects[removedObjects[i]].at("uniqueID").get<int>();
+                const std::string removedKey = std::to_string(removedId);
+                variationsOutput[removedKey] = outputs[i];
+
+                for (const auto& id : getDifferentEvents(original.at("causal_graph"), outputs[i].at("causal_graph"), objects, removedId))
+                {
+                    enables.push_back({ { removedKey, id } });
+                }
+                for (const auto& id : getDifferentEvents(outputs[i].at("causal_graph"), original.at("causal_graph"), objects, removedId))
+                {
+                    prevents.push_back({ { removedKey, id } });
+                }
+            }
+
+            json output = json::object();
+            output.emplace("original_video_output", original);
+            output.emplace("variations_outputs", variationsOutput);
+            output.emplace("enables", enables);
+            output.emplace("prevents", prevents);
+            if (!JSONHelper::saveJSON(output, variationsOutputPath))
+            {
+                fprintf(stderr, "Could not write %s\n", variationsOutputPath.c_str());
+                return -1;
+            }
+            return 0;
+        }
+
+    private:
+        // Runs the scene without the removed object, or resumes the checkpoint without it when there is
+        // one. Failures are reported through the return value since this runs on the worker threads.
+        static bool runVariation(const json& controller, const json& scene, const SimulationBase::Checkpoint* checkpoint, const int& removedId, json& output)
+        {
+            try
+            {
+                SimulationBase::Ptr simulation = parse(controller);
+                if (checkpoint)
+                    simulation->resumeFromCheckpoint(*checkpoint, removedId);
+                else
+                    simulation->setInputScene(scene);
+
+                Settings* settings = simulation->getSettings().get();
+                while (!simulation->isFinished())
+                {
+                    simulation->Step(settings);
+                }
+                output = simulation->getOutputJSON();
+                return true;
+            }
+            catch (const char* error)
+            {
+                fprintf(stderr, "Variation without object %d: %s\n", removedId, error);
+            }
+            catch (const std::exception& error)
+            {
+                fprintf(stderr, "Variation without object %d: %s\n", removedId, error.what());
+            }
+            return false;
+        }
+
+        // Runs the start scene up to lastStep, keeping a checkpoint every checkpointInterval steps.
+        // Stops at the first world that cannot be cloned, variations fall back to the earlier checkpoints or a full rerun.
+        static void runReference(const SimulationBase::Ptr& simulation, const json& scene, const int& lastStep, std::vector<SimulationBase::Checkpoint::Ptr>& checkpoints)
+        {
+            simulation->setInputScene(scene);
+
+            Settings* settings = simulation->getSettings().get();
+            while (!simulation->isFinished() && simulation->getStepCount() < lastStep)
+            {
+                simulation->Step(settings);
+                if (!simulation->isFinished() && simulation->getStepCount() % settings->checkpointInterval == 0)
+                {
+                    SimulationBase::Checkpoint::Ptr checkpoint = simulation->saveCheckpoint();
+                    if (!checkpoint)
+                        return;
+                    checkpoints.push_back(checkpoint);
+                }
+            }
+        }
+
+        // Step of the earliest event of an object, events are stamped with the step their contact began at.
+        static int getFirstEventStep(const json& causalGraph, const int& objectId)
+        {
+            int firstStep = std::numeric_limits<int>::max();
+            for (const auto& event : causalGraph.at("nodes"))
+            {
+                const std::vector<int> eventObjects = event.at("objects").get<std::vector<int>>();
+                if (std::find(eventObjects.begin(), eventObjects.end(), objectId) != eventObjects.end())
+                    firstStep = std::min(firstStep, event.at("step").get<int>());
+            }
+            return firstStep;
+        }
+
+        // Events of src that have no event of the same type between the same objects in compare,
+        // leaving out events of the removed object and of platforms, in step order.
+        static std::vector<json> getDifferentEvents(const json& src, const json& compare, const json& objects, const int& removedId)
+        {
+            std::vector<int> discardedIds;
+            for (const auto& object : objects)
+            {
+                if (object.at("shape") == "platform")
+                    discardedIds.push_back(object.at("uniqueID").get<int>());
+            }
+
+            std::vector<json> srcEvents(src.at("nodes").begin(), src.at("nodes").end());
+            std::stable_sort(srcEvents.begin(), srcEvents.end(), [](const json& a, const json& b)
+            {
+                return a.at("step").get<int>() < b.at("step").get<int>();
+            });
+
+            std::vector<json> ids;
+            for (const auto& srcEvent : srcEvents)
+            {
+                const std::vector<int> srcObjects = srcEvent.at("objects").get<std::vector<int>>();
+                if (std::find(srcObjects.begin(), srcObjects.end(), removedId) != srcObjects.end())
+                    continue;
+                if (std::find_first_of(srcObjects.begin(), srcObjects.end(), discardedIds.begin(), discardedIds.end()) != srcObjects.end())
+                    continue;
+
+                bool foundEqual = false;
+                for (const auto& compareEvent : compare.at("nodes"))
+                {
+                    if (isEqualWithoutStep(srcEvent, compareEvent))
+                    {
+                        foundEqual = true;
+                        break;
+                    }
+                }
+                if (!foundEqual)
+                    ids.push_back(srcEvent.at("id"));
+            }
+            return ids;
+        }
+
+        static bool isEqualWithoutStep(const json& event1, const json& event2)
+        {
+            std::vector<int> objects1 = event1.at("objects").get<std::vector<int>>();
+            std::vector<int> objects2 = event2.at("objects").get<std::vector<int>>();
+            std::sort(objects1.begin(), objects1.end());
+            objects1.erase(std::unique(objects1.begin(), objects1.end()), objects1.end());
+            std::sort(objects2.begin(), objects2.end());
+            objects2.erase(std::unique(objects2.begin(), objects2.end()), objects2.end());
+            return objects1 == objects2 && event1.at("type") == event2.at("type");
+        }
+    };
+}
+
+#endif /* VariationRunner_h */
@@ -0,0 +1,381 @@
+//
+//  VideoWriter.cpp
+//  Testbed
+//
+
+#include "VideoWriter.hpp"
+#include "FrameSampling.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <stdlib.h>
+#include <string.h>
+
+VideoWriter::VideoWriter()
+{
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_nOutputWidth = 0;
+    m_nOutputHeight = 0;
+    m_nFps = 0;
+    m_fSourceFps = 0.0f;
+    m_nPts = 0;
+
+    m_pFormatContext = NULL;
+    m_pStream = NULL;
+    m_pCodecContext = NULL;
+    m_pFrame = NULL;
+    m_pPacket = NULL;
+    m_pSwsContext = NULL;
+
+    for (int i = 0; i < e_frameQueueLength; ++i)
+    {
+        m_pFrameBuffers[i] = NULL;
+        m_bYuvFrames[i] = false;
+    }
+
+    m_nHead = 0;
+    m_nTail = 0;
+    m_bClosing = false;
+}
+
+VideoWriter::~VideoWriter()
+{
+    Close();
+}
+
+/* Allocate resources, write the container header and start the encoder thread. */
+bool VideoWriter::Open(const std::string& filePath, const int& width, const int& height, const VideoWriterOptions& options)
+{
+    if (avformat_alloc_output_context2(&m_pFormatContext, NULL, NULL, filePath.c_str()) < 0 || !m_pFormatContext) {
+        fprintf(stderr, "Could not deduce output format from %s\n", filePath.c_str());
+        return false;
+    }
+
+    const AVCodec* codec = avcodec_find_encoder_by_name(options.codec.c_str());
+    if (!codec) {
+        fprintf(stderr, "Codec %s not found\n", options.codec.c_str());
+        return false;
+    }
+    m_pStream = avformat_new_stream(m_pFormatContext, NULL);
+    m_pCodecContext = avcodec_alloc_context3(codec);
+    if (!m_pStream || !m_pCodecContext) {
+        fprintf(stderr, "Could not allocate video codec context\n");
+        return false;
+    }
+    m_pCodecContext->width = options.width > 0 ? options.width : width;
+    m_pCodecContext->height = options.height > 0 ? options.height : height;
+    m_pCodecContext->time_base.num = 1;
+    m_pCodecContext->time_base.den = options.fps;
+    m_pCodecContext->framerate.num = options.fps;
+    m_pCodecContext->framerate.den = 1;
+    m_pCodecContext->gop_size = options.gopSize;
+    m_pCodecContext->thread_count = options.threadCount;
+    m_pCodecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+    // Lets MPEG-1/2 use the unofficial 5, 10, 12 and 15 fps frame rate codes, see SupportsFps.
+    m_pCodecContext->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+    if (m_pFormatContext->oformat->flags & AVFMT_GLOBALHEADER)
+        m_pCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    // Options the encoder does not know are left in the dictionary and ignored.
+    AVDictionary* codecOptions = NULL;
+    if (!options.preset.empty())
+        av_dict_set(&codecOptions, "preset", options.preset.c_str(), 0);
+    if (options.crf >= 0) {
+        av_dict_set(&codecOptions, "crf", std::to_string(options.crf).c_str(), 0);
+        m_pCodecContext->bit_rate = 0;
+    }
+    else m_pCodecContext->bit_rate = options.bitRate;
+
+    const int ret = avcodec_open2(m_pCodecContext, codec, &codecOptions);
+    av_dict_free(&codecOptions);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open codec %s\n", options.codec.c_str());
+        return false;
+    }
+
+    m_pStream->time_base = m_pCodecContext->time_base;
+    if (avcodec_parameters_from_context(m_pStream->codecpar, m_pCodecContext) < 0) {
+        fprintf(stderr, "Could not copy the stream parameters\n");
+        return false;
+    }
+    if (!(m_pFormatContext->oformat->flags & AVFMT_NOFILE)
+        && avio_open(&m_pFormatContext->pb, filePath.c_str(), AVIO_FLAG_WRITE) < 0) {
+        fprintf(stderr, "Could not open %s\n", filePath.c_str());
+        return false;
+    }
+    if (avformat_write_header(m_pFormatContext, NULL) < 0) {
+        fprintf(stderr, "Could not write the header of %s\n", filePath.c_str());
+        return false;
+    }
+
+    m_pFrame = av_frame_alloc();
+    m_pPacket = av_packet_alloc();
+    if (!m_pFrame || !m_pPacket) {
+        fprintf(stderr, "Could not allocate video frame\n");
+        return false;
+    }
+    m_pFrame->format = m_pCodecContext->pix_fmt;
+    m_pFrame->width  = m_pCodecContext->width;
+    m_pFrame->height = m_pCodecContext->height;
+    if (av_frame_get_buffer(m_pFrame, 0) < 0) {
+        fprintf(stderr, "Could not allocate raw picture buffer\n");
+        return false;
+    }
+
+    m_nWidth = width;
+    m_nHeight = height;
+    m_nOutputWidth = m_pCodecContext->width;
+    m_nOutputHeight = m_pCodecContext->height;
+    m_nFps = options.fps;
+    m_fSourceFps = options.sourceFps;
+    m_nPts = 0;
+
+    for (int i = 0; i < e_frameQueueLength; ++i)
+    {
+        m_pFrameBuffers[i] = (unsigned char*)malloc(sizeof(unsigned char) * 3 * width * height);
+    }
+
+    m_nHead = 0;
+    m_nTail = 0;
+    m_bClosing = false;
+    m_EncoderThread = std::thread(&VideoWriter::EncoderLoop, this);
+
+    return true;
+}
+
+bool VideoWriter::SupportsFps(const std::string& codec, const int& fps)
+{
+    // The frame rate codes of MPEG-1/2, the unofficial ones included.
+    static const int frameRates[] = { 24, 25, 30, 50, 60, 5, 10, 12, 15 };
+    const bool mpeg1 = codec == "mpeg1video";
+    if (!mpeg1 && codec != "mpeg2video")
+        return true;
+
+    // MPEG-2 scales them by (n + 1) / (d + 1), with n below 4 and d below 32.
+    for (const int& frameRate : frameRates)
+    {
+        for (int n = 0; n < (mpeg1 ? 1 : 4); ++n)
+        {
+            for (int d = 0; d < (mpeg1 ? 1 : 32); ++d)
+            {
+                if (frameRate * (n + 1) == fps * (d + 1))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool VideoWriter::AcceptsFrame(const int& frameIndex) const
+{
+    return isFrameSampled(frameIndex, m_nFps, m_fSourceFps);
+}
+
+unsigned char* VideoWriter::AcquireFrame()
+{
+    const unsigned int head = m_nHead.load(std::memory_order_relaxed);
+    if (head - m_nTail.load(std::memory_order_acquire) == e_frameQueueLength)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_SlotFree.wait(lock, [&] { return head - m_nTail.load(std::memory_order_acquire) < e_frameQueueLength; });
+    }
+    return m_pFrameBuffers[head % e_frameQueueLength];
+}
+
+void VideoWriter::SubmitFrame()
+{
+    Submit(false);
+}
+
+bool VideoWriter::AcceptsYuvFrames() const
+{
+    return m_nOutputWidth == m_nWidth && m_nOutputHeight == m_nHeight;
+}
+
+void VideoWriter::SubmitYuvFrame()
+{
+    Submit(true);
+}
+
+void VideoWriter::Submit(const bool& yuv)
+{
+    const unsigned int head = m_nHead.load(std::memory_order_relaxed);
+    m_bYuvFrames[head % e_frameQueueLength] = yuv;
+    m_nHead.store(head + 1, std::memory_order_release);
+
+    // Taking the mutex makes sure the encoder is not between its check and its wait.
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+    }
+    m_FrameReady.notify_one();
+}
+
+void VideoWriter::EncoderLoop()
+{
+    while (true)
+    {
+        const unsigned int tail = m_nTail.load(std::memory_order_relaxed);
+        if (tail == m_nHead.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_FrameReady.wait(lock, [&]
+            {
+                return tail != m_nHead.load(std::memory_order_acquire) || m_bClosing.load(std::memory_order_acquire);
+            });
+            // Every frame submitted before Close() is visible once the flag is.
+            if (tail == m_nHead.load(std::memory_order_acquire))
+            {
+                break;
+            }
+        }
+
+        if (m_bYuvFrames[tail % e_frameQueueLength])
+            EncodeYuvFrame(m_pFrameBuffers[tail % e_frameQueueLength]);
+        else
+            EncodeFrame(m_pFrameBuffers[tail % e_frameQueueLength]);
+        m_nTail.store(tail + 1, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+        }
+        m_SlotFree.notify_one();
+    }
+}
+
+/*
+Convert the bottom-up RGB24 frame to YUV and encode it. Starting from the last row
+with a negative stride makes sws_scale flip the image on the way. Frames encoded at
+another size are scaled in the same pass with an area (box) filter.
+*/
+void VideoWriter::EncodeFrame(const unsigned char* rgb)
+{
+    const uint8_t* lastRow = rgb + 3 * m_nWidth * (m_nHeight - 1);
+    const int in_linesize[1] = { -3 * m_nWidth };
+    const bool scaled = m_nOutputWidth != m_nWidth || m_nOutputHeight != m_nHeight;
+    m_pSwsContext = sws_getCachedContext(m_pSwsContext,
+            m_nWidth, m_nHeight, AV_PIX_FMT_RGB24,
+            m_nOutputWidth, m_nOutputHeight, AV_PIX_FMT_YUV420P,
+            scaled ? SWS_AREA : 0, 0, 0, 0);
+    // The encoder may still reference the previous picture.
+    if (av_frame_make_writable(m_pFrame) < 0) {
+        fprintf(stderr, "Could not make the video frame writable\n");
+        exit(1);
+    }
+    sws_scale(m_pSwsContext, &lastRow, in_linesize, 0,
+            m_nHeight, m_pFrame->data, m_pFrame->linesize);
+
+    m_pFrame->pts = m_nPts++;
+    WritePackets(m_pFrame);
+}
+
+/* Copy the planes converted on the GPU into the frame, whose rows may be padded, and encode it. */
+void VideoWriter::EncodeYuvFrame(const unsigned char* yuv)
+{
+    if (av_frame_make_writable(m_pFrame) < 0) {
+        fprintf(stderr, "Could not make the video frame writable\n");
+        exit(1);
+    }
+    const unsigned char* plane = yuv;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int width = i == 0 ? m_nWidth : m_nWidth / 2;
+        const int height = i == 0 ? m_nHeight : m_nHeight / 2;
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(m_pFrame->data[i] + y * m_pFrame->linesize[i], plane + y * width, width);
+        }
+        plane += width * height;
+    }
+
+    m_pFrame->pts = m_nPts++;
+    WritePackets(m_pFrame);
+}
+
+/* Send one frame, or flush the encoder when frame is NULL, and mux the packets it produces. */
+void VideoWriter::WritePackets(AVFrame* frame)
+{
+    if (avcodec_send_frame(m_pCodecContext, frame) < 0) {
+        fprintf(stderr, "Error encoding frame\n");
+        exit(1);
+    }
+    while (true) {
+        const int ret = avcodec_receive_packet(m_pCodecContext, m_pPacket);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            fprintf(stderr, "Error encoding frame\n");
+            exit(1);
+        }
+        av_packet_rescale_ts(m_pPacket, m_pCodecContext->time_base, m_pStream->time_base);
+        m_pPacket->stream_index = m_pStream->index;
+        // Takes ownership of the packet data and resets the packet.
+        if (av_interleaved_write_frame(m_pFormatContext, m_pPacket) < 0) {
+            fprintf(stderr, "Error writing packet\n");
+            exit(1);
+        }
+    }
+}
+
+/*
+Wait for the queued frames, write trailing data to the output file
+and free resources allocated by Open.
+*/
+void VideoWriter::Close()
+{
+    if (m_EncoderThread.joinable())
+    {
+        m_bClosing.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+        }
+        m_FrameReady.notify_one();
+        m_EncoderThread.join();
+
+        WritePackets(NULL);
+        av_write_trailer(m_pFormatContext);
+    }
+
+    if (m_pFormatContext)
+    {
+        if (!(m_pFormatContext->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&m_pFormatContext->pb);
+        avformat_free_context(m_pFormatContext);
+        m_pFormatContext = NULL;
+        m_pStream = NULL;
+    }
+    if (m_pCodecContext)
+    {
+        avcodec_free_context(&m_pCodecContext);
+    }
+    if (m_pFrame)
+    {
+        av_frame_free(&m_pFrame);
+    }
+    if (m_pPacket)
+    {
+        av_packet_free(&m_pPacket);
+    }
+    if (m_pSwsContext)
+    {
+        sws_freeContext(m_pSwsContext);
+        m_pSwsContext = NULL;
+    }
+
+    for (int i = 0; i < e_frameQueueLength; ++i)
+    {
+        free(m_pFrameBuffers[i]);
+        m_pFrameBuffers[i] = NULL;
+    }
+}
+
+bool VideoWriter::isOpen() const
+{
+    return m_EncoderThread.joinable();
+}
@@ -0,0 +1,115 @@
+//
+//  VideoWriter.hpp
+//  Testbed
+//
+
+#ifndef VideoWriter_hpp
+#define VideoWriter_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+struct SwsContext;
+
+// Encoder settings, filled from the controller JSON.
+struct VideoWriterOptions
+{
+    std::string codec = "mpeg1video"; // Any FFmpeg encoder name, e.g. libx264, ffv1, libvpx-vp9.
+    std::string preset = "ultrafast"; // Only used by encoders that have a preset option.
+    float sourceFps = 60.0f;          // Rate frames are rendered at, one per simulation step.
+    int fps = 60;                     // Frames are dropped evenly when lower than sourceFps.
+    int gopSize = 25;
+    int crf = -1;                     // Constant quality instead of bitRate when not negative.
+    int64_t bitRate = 4000000;
+    int threadCount = 0;              // 0 lets the encoder pick.
+    int width = 0;                    // Encoded size, 0 for the size of the rendered frames. Other sizes
+    int height = 0;                   // are area filtered on the encoder thread, keep the aspect ratio.
+};
+
+// Encodes RGB24 frames and muxes them into a video file on its own thread.
+// The container is picked from the file extension (mp4, mkv, mpg, ...).
+// The simulation thread fills a slot of a bounded single-producer/single-consumer
+// ring (AcquireFrame/SubmitFrame) and moves on; the encoder thread converts,
+// encodes and writes the frames in submission order. Either side sleeps on a
+// condition variable while the ring is full or empty, the indices stay lock-free.
+class VideoWriter
+{
+public:
+    VideoWriter();
+    virtual ~VideoWriter();
+
+    // width x height is the size of the frames handed in, options.width x options.height the encoded size.
+    bool Open(const std::string& filePath, const int& width, const int& height, const VideoWriterOptions& options);
+
+    // Whether the encoder named codec can write fps frames per second. MPEG-1 only has a fixed
+    // set of frame rates, MPEG-2 also fractions of them; other encoders take any rate.
+    static bool SupportsFps(const std::string& codec, const int& fps);
+
+    // Whether the frameIndex-th rendered frame belongs to this video at its frame rate.
+    bool AcceptsFrame(const int& frameIndex) const;
+
+    // Returns a width * height * 3 buffer for the next frame, rows bottom-up as read from OpenGL.
+    // Blocks only while all slots are waiting to be encoded.
+    unsigned char* AcquireFrame();
+
+    // Hands the buffer returned by AcquireFrame over to the encoder thread.
+    void SubmitFrame();
+
+    // Whether frames can be handed in as YUV420P instead, i.e. they are encoded at the size they are rendered at.
+    bool AcceptsYuvFrames() const;
+
+    // Like SubmitFrame for a buffer filled with top-down YUV420P planes: width * height bytes
+    // of Y followed by the quarter-size U and V planes.
+    void SubmitYuvFrame();
+
+    // Encodes the queued frames, flushes the encoder and closes the file.
+    void Close();
+
+    bool isOpen() const;
+
+private:
+    enum { e_frameQueueLength = 8 };
+
+    void Submit(const bool& yuv);
+    void EncoderLoop();
+    void EncodeFrame(const unsigned char* rgb);
+    void EncodeYuvFrame(const unsigned char* yuv);
+    void WritePackets(AVFrame* frame);
+
+    int m_nWidth;
+    int m_nHeight;
+    int m_nOutputWidth;
+    int m_nOutputHeight;
+    int m_nFps;
+    float m_fSourceFps;
+    int64_t m_nPts;
+
+    AVFormatContext* m_pFormatContext;
+    AVStream* m_pStream;
+    AVCodecContext* m_pCodecContext;
+    AVFrame* m_pFrame;
+    AVPacket* m_pPacket;
+    SwsContext* m_pSwsContext;
+
+    unsigned char* m_pFrameBuffers[e_frameQueueLength];
+    bool m_bYuvFrames[e_frameQueueLength];
+    std::atomic<unsigned int> m_nHead;  // Written by the simulation thread only.
+    std::atomic<unsigned int> m_nTail;  // Written by the encoder thread only.
+    std::atomic<bool> m_bClosing;
+    std::mutex m_Mutex;                 // Only guards the waits below against missed notifications.
+    std::condition_variable m_SlotFree;
+    std::condition_variable m_FrameReady;
+    std::thread m_EncoderThread;
+};
+
+#endif /* VideoWriter_hpp */
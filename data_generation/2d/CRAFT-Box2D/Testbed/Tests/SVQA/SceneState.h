@@ -8,7 +8,9 @@
 #ifndef SceneState_h
 #define SceneState_h
 
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 #include "SimulationDefines.h"
 #include <nlohmann/json.hpp>
 #include "ObjectState.h"
@@ -29,6 +31,42 @@ struct SceneState {
 		objects.clear();
 	}
 
+	void remove(const b2Body* body)
+	{
+		objects.erase(std::remove_if(objects.begin(), objects.end(),
+			[body](const ObjectState::Ptr& objState) { return objState->body == body; }), objects.end());
+	}
+
+	// Makes this the state of toWorld, a copy of fromWorld made by b2World::Clone or Restore, from
+	// the state of fromWorld. The objects are copied and pointed at the bodies of toWorld, whose user
+	// data is pointed at the copies. Sensor bodies are pointed at the copy of their attached body.
+	void cloneFrom(const SceneState& state, const WORLD* fromWorld, WORLD* toWorld)
+	{
+		// Both worlds list their bodies in the same order.
+		std::unordered_map<const b2Body*, b2Body*> bodies;
+		const b2Body* from = fromWorld->GetBodyList();
+		for (b2Body* to = toWorld->GetBodyList(); from && to; from = from->GetNext(), to = to->GetNext())
+		{
+			bodies[from] = to;
+		}
+
+		for (const auto& body : bodies)
+		{
+			auto attachedBody = bodies.find((const b2Body*)body.first->GetUserData());
+			if (attachedBody != bodies.end())
+				body.second->SetUserData(attachedBody->second);
+		}
+
+		clear();
+		for (const auto& object : state.objects)
+		{
+			ObjectState::Ptr oState = std::make_shared<ObjectState>(*object);
+			oState->body = (BODY*)bodies.at(object->body);
+			oState->body->SetUserData(oState.get());
+			add(oState);
+		}
+	}
+
 	bool loadFromJSON(const json& j, WORLD* toWorld, float noiseAmount, int perturbationSeed)
 	{
 		//FIXME: Read directions and apply transformation if they can be updated
@@ -13,6 +13,8 @@
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include "SimulationID.h"
+#include "VideoWriter.hpp"
+#include "ImageWriter.hpp"
 
 using json = nlohmann::json;
 
@@ -37,6 +39,48 @@ namespace svqa
         bool includeDynamicObjectsInTheScene;
         std::string screenshotOutputFolder;
         std::string snapshotOutputFolder;
+        std::string renderBackend;
+        VideoWriterOptions video;
+
+        // Extra videos of the same run at their own frame rate and, optionally, codec and size; the other
+        // options are the ones above. Frames are drawn once at width x height and scaled down per video,
+        // so render at the largest size and keep the aspect ratio. The default mpeg1video codec only
+        // takes 5, 10, 12, 15, 24, 25, 30, 50 or 60 fps, pick another one for other rates.
+        struct VideoOutput
+        {
+            std::string path;
+            VideoWriterOptions options;
+        };
+        std::vector<VideoOutput> additionalVideoOutputs;
+
+        // Frames as an (N, H, W, 3) uint8 .npy array, not written when the path is empty. Here and
+        // below, frames are the rendered ones: one every renderEveryNSteps steps.
+        std::string frameArrayOutputPath;
+        int frameArrayFps;
+
+        // first.png, last.png and every frameImageInterval-th frame (0 for none), not written when the folder is empty.
+        std::string frameImageOutputFolder;
+        int frameImageInterval;
+
+        // mask_NNNNNN.png every instanceMaskInterval-th frame, not written when the folder is empty: 16-bit
+        // grayscale with the uniqueID + 1 of the body at each pixel and 0 for the background and sensors.
+        std::string instanceMaskOutputFolder;
+        int instanceMaskInterval;
+
+        // Used for every PNG the renderer writes, screenshots included.
+        ImageWriterOptions png;
+
+        // Anti-aliasing of the rendered frames: samples per pixel (0, 2, 4, 8 or 16) and the factor
+        // frames are rendered larger by before being box filtered down (1, 2 or 4).
+        int msaaSamples;
+        int supersampling;
+
+        // Videos at the rendered size get frames converted to YUV420P on the GPU, egl backend only.
+        bool gpuYuvConversion;
+
+        // Counterfactual variations (--variations) resume from in-memory checkpoints taken every
+        // checkpointInterval steps of a rerun of the original (0 to simulate every variation from the start).
+        int checkpointInterval;
         
         void to_json(json& j) {
             j.emplace("simulationID", (int)this->simulationID);
@@ -53,6 +97,40 @@ namespace svqa
             j.emplace("snapshotOutputFolder",   this->snapshotOutputFolder);
             j.emplace("noiseAmount", this->noiseAmount);
             j.emplace("perturbationSeed", this->perturbationSeed);
+            j.emplace("renderBackend", this->renderBackend);
+            j.emplace("renderEveryNSteps", this->renderEveryNSteps);
+            j.emplace("videoCodec", this->video.codec);
+            j.emplace("videoPreset", this->video.preset);
+            j.emplace("videoFps", this->video.fps);
+            j.emplace("videoGopSize", this->video.gopSize);
+            j.emplace("videoCrf", this->video.crf);
+            j.emplace("videoBitRate", this->video.bitRate);
+            j.emplace("videoThreadCount", this->video.threadCount);
+
+            auto additionalVideoOutputs = json::array();
+            for (const auto& output : this->additionalVideoOutputs)
+            {
+                additionalVideoOutputs.push_back({
+                    {"path", output.path},
+                    {"fps", output.options.fps},
+                    {"codec", output.options.codec},
+                    {"width", output.options.width > 0 ? output.options.width : this->bufferWidth},
+                    {"height", output.options.height > 0 ? output.options.height : this->bufferHeight}
+                });
+            }
+            j.emplace("additionalVideoOutputs", additionalVideoOutputs);
+            j.emplace("frameArrayOutputPath", this->frameArrayOutputPath);
+            j.emplace("frameArrayFps", this->frameArrayFps);
+            j.emplace("frameImageOutputFolder", this->frameImageOutputFolder);
+            j.emplace("frameImageInterval", this->frameImageInterval);
+            j.emplace("instanceMaskOutputFolder", this->instanceMaskOutputFolder);
+            j.emplace("instanceMaskInterval", this->instanceMaskInterval);
+            j.emplace("pngCompressionLevel", this->png.compressionLevel);
+            j.emplace("pngFilter", this->png.filter);
+            j.emplace("msaaSamples", this->msaaSamples);
+            j.emplace("supersampling", this->supersampling);
+            j.emplace("gpuYuvConversion", this->gpuYuvConversion);
+            j.emplace("checkpointInterval", this->checkpointInterval);
         }
 
         void from_json(const json& j) {
@@ -133,6 +211,322 @@ namespace svqa
             {
                 this->perturbationSeed = -1;
             }
+
+            // Physics and event detection still run every step, so step counts do not change.
+            auto renderEveryNSteps = j.find("renderEveryNSteps");
+            if (renderEveryNSteps != j.end())
+            {
+                this->renderEveryNSteps = *renderEveryNSteps;
+                if (this->renderEveryNSteps <= 0)
+                {
+                    throw "Render every n steps must be positive";
+                }
+                if (this->renderEveryNSteps > 1 && !this->offline)
+                {
+                    throw "Render every n steps can only be used offline";
+                }
+            }
+            else
+            {
+                this->renderEveryNSteps = 1;
+            }
+
+            // One frame is rendered every renderEveryNSteps steps.
+            this->video.sourceFps = this->hz / this->renderEveryNSteps;
+            this->video.fps = (int)this->video.sourceFps;
+
+            // Missing video keys keep the defaults of VideoWriterOptions, the fps that of the rendered frames.
+            auto videoCodec = j.find("videoCodec");
+            if (videoCodec != j.end())
+            {
+                this->video.codec = *videoCodec;
+            }
+
+            auto videoPreset = j.find("videoPreset");
+            if (videoPreset != j.end())
+            {
+                this->video.preset = *videoPreset;
+            }
+
+            auto videoFps = j.find("videoFps");
+            if (videoFps != j.end())
+            {
+                this->video.fps = *videoFps;
+                if (this->video.fps <= 0)
+                {
+                    throw "Video fps must be positive";
+                }
+            }
+
+            if (this->outputVideoPath != "" && !VideoWriter::SupportsFps(this->video.codec, this->video.fps))
+            {
+                throw "Video fps is not supported by the codec: mpeg1video takes 5, 10, 12, 15, 24, 25, 30, 50 or 60 fps, mpeg2video also fractions of these";
+            }
+
+            auto videoGopSize = j.find("videoGopSize");
+            if (videoGopSize != j.end())
+            {
+                this->video.gopSize = *videoGopSize;
+            }
+
+            auto videoCrf = j.find("videoCrf");
+            if (videoCrf != j.end())
+            {
+                this->video.crf = *videoCrf;
+            }
+
+            auto videoBitRate = j.find("videoBitRate");
+            if (videoBitRate != j.end())
+            {
+                this->video.bitRate = *videoBitRate;
+            }
+
+            auto videoThreadCount = j.find("videoThreadCount");
+            if (videoThreadCount != j.end())
+            {
+                this->video.threadCount = *videoThreadCount;
+            }
+
+            this->additionalVideoOutputs.clear();
+            auto additionalVideoOutputs = j.find("additionalVideoOutputs");
+            if (additionalVideoOutputs != j.end())
+            {
+                for (const auto& outputJson : *additionalVideoOutputs)
+                {
+                    VideoOutput output;
+                    output.options = this->video;
+                    outputJson.at("path").get_to(output.path);
+                    outputJson.at("fps").get_to(output.options.fps);
+                    if (output.options.fps <= 0)
+                    {
+                        throw "Video fps must be positive";
+                    }
+
+                    auto codec = outputJson.find("codec");
+                    if (codec != outputJson.end())
+                    {
+                        output.options.codec = *codec;
+                    }
+                    if (!VideoWriter::SupportsFps(output.options.codec, output.options.fps))
+                    {
+                        throw "Video fps is not supported by the codec: mpeg1video takes 5, 10, 12, 15, 24, 25, 30, 50 or 60 fps, mpeg2video also fractions of these";
+                    }
+
+                    auto width = outputJson.find("width");
+                    auto height = outputJson.find("height");
+                    if ((width != outputJson.end()) != (height != outputJson.end()))
+                    {
+                        throw "Video outputs need both width and height, or neither";
+                    }
+                    if (width != outputJson.end())
+                    {
+                        output.options.width = *width;
+                        output.options.height = *height;
+                        if (output.options.width <= 0 || output.options.height <= 0
+                            || output.options.width % 2 != 0 || output.options.height % 2 != 0)
+                        {
+                            throw "Video width and height must be positive and even";
+                        }
+                    }
+                    this->additionalVideoOutputs.push_back(output);
+                }
+            }
+
+            auto frameArrayOutputPath = j.find("frameArrayOutputPath");
+            if (frameArrayOutputPath != j.end())
+            {
+                this->frameArrayOutputPath = *frameArrayOutputPath;
+            }
+            else
+            {
+                this->frameArrayOutputPath = "";
+            }
+
+            auto frameArrayFps = j.find("frameArrayFps");
+            if (frameArrayFps != j.end())
+            {
+                this->frameArrayFps = *frameArrayFps;
+                if (this->frameArrayFps <= 0)
+                {
+                    throw "Frame array fps must be positive";
+                }
+            }
+            else
+            {
+                this->frameArrayFps = (int)this->video.sourceFps;
+            }
+
+            auto frameImageOutputFolder = j.find("frameImageOutputFolder");
+            if (frameImageOutputFolder != j.end())
+            {
+                this->frameImageOutputFolder = *frameImageOutputFolder;
+            }
+            else
+            {
+                this->frameImageOutputFolder = "";
+            }
+
+            auto frameImageInterval = j.find("frameImageInterval");
+            if (frameImageInterval != j.end())
+            {
+                this->frameImageInterval = *frameImageInterval;
+            }
+            else
+            {
+                this->frameImageInterval = 0;
+            }
+
+            auto instanceMaskOutputFolder = j.find("instanceMaskOutputFolder");
+            if (instanceMaskOutputFolder != j.end())
+            {
+                this->instanceMaskOutputFolder = *instanceMaskOutputFolder;
+            }
+            else
+            {
+                this->instanceMaskOutputFolder = "";
+            }
+
+            auto instanceMaskInterval = j.find("instanceMaskInterval");
+            if (instanceMaskInterval != j.end())
+            {
+                this->instanceMaskInterval = *instanceMaskInterval;
+                if (this->instanceMaskInterval <= 0)
+                {
+                    throw "Instance mask interval must be positive";
+                }
+            }
+            else
+            {
+                this->instanceMaskInterval = 1;
+            }
+
+            auto pngCompressionLevel = j.find("pngCompressionLevel");
+            if (pngCompressionLevel != j.end())
+            {
+                this->png.compressionLevel = *pngCompressionLevel;
+                if (this->png.compressionLevel < -1 || this->png.compressionLevel > 9)
+                {
+                    throw "PNG compression level must be between 0 and 9, or -1 for the default";
+                }
+            }
+
+            auto pngFilter = j.find("pngFilter");
+            if (pngFilter != j.end())
+            {
+                std::string value = *pngFilter;
+                if (value != "none"
+                    && value != "sub"
+                    && value != "up"
+                    && value != "average"
+                    && value != "paeth"
+                    && value != "all")
+                {
+                    throw "PNG filter must be one of the following: none, sub, up, average, paeth, all";
+                }
+
+                this->png.filter = value;
+            }
+
+            // Nothing has to be drawn when no video, screenshot or window is going to show the frames.
+            const bool consumesFrames = !this->offline
+                || this->outputVideoPath != ""
+                || !this->additionalVideoOutputs.empty()
+                || this->frameArrayOutputPath != ""
+                || this->frameImageOutputFolder != ""
+                || this->instanceMaskOutputFolder != ""
+                || this->screenshotOutputFolder != ""
+                || !this->includeDynamicObjectsInTheScene;
+
+            auto renderBackend = j.find("renderBackend");
+            if (renderBackend != j.end())
+            {
+                std::string value = *renderBackend;
+                if (value != "window"
+                    && value != "egl"
+                    && value != "software"
+                    && value != "none")
+                {
+                    throw "Render backend must be one of the following: window, egl, software, none";
+                }
+                if (value == "none" && consumesFrames)
+                {
+                    throw "Render backend none can only be used offline without video or screenshot outputs";
+                }
+
+                this->renderBackend = value;
+            }
+            else
+            {
+                this->renderBackend = consumesFrames ? "window" : "none";
+            }
+            this->renderFrames = this->renderBackend != "none";
+
+            auto msaaSamples = j.find("msaaSamples");
+            if (msaaSamples != j.end())
+            {
+                this->msaaSamples = *msaaSamples;
+                if (this->msaaSamples != 0
+                    && this->msaaSamples != 2
+                    && this->msaaSamples != 4
+                    && this->msaaSamples != 8
+                    && this->msaaSamples != 16)
+                {
+                    throw "MSAA samples must be one of the following: 0, 2, 4, 8, 16";
+                }
+            }
+            else
+            {
+                // Windows used to request 16 samples, offscreen frames were never multisampled.
+                this->msaaSamples = this->renderBackend == "window" ? 16 : 0;
+            }
+
+            auto supersampling = j.find("supersampling");
+            if (supersampling != j.end())
+            {
+                this->supersampling = *supersampling;
+                if (this->supersampling != 1
+                    && this->supersampling != 2
+                    && this->supersampling != 4)
+                {
+                    throw "Supersampling must be one of the following: 1, 2, 4";
+                }
+            }
+            else
+            {
+                this->supersampling = 1;
+            }
+
+            auto gpuYuvConversion = j.find("gpuYuvConversion");
+            if (gpuYuvConversion != j.end())
+            {
+                this->gpuYuvConversion = *gpuYuvConversion;
+                if (this->gpuYuvConversion && this->renderBackend != "egl")
+                {
+                    throw "GPU YUV conversion can only be used with the egl render backend";
+                }
+                if (this->gpuYuvConversion && (this->bufferWidth % 2 != 0 || this->bufferHeight % 2 != 0))
+                {
+                    throw "GPU YUV conversion needs an even width and height";
+                }
+            }
+            else
+            {
+                this->gpuYuvConversion = false;
+            }
+
+            auto checkpointInterval = j.find("checkpointInterval");
+            if (checkpointInterval != j.end())
+            {
+                this->checkpointInterval = *checkpointInterval;
+                if (this->checkpointInterval < 0)
+                {
+                    throw "Checkpoint interval cannot be negative";
+                }
+            }
+            else
+            {
+                this->checkpointInterval = 10;
+            }
         }
     };
 }
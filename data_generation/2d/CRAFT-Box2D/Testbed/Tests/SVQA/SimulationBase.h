@@ -34,8 +34,13 @@
 namespace svqa {
 #define RENDERER ((SimulationRenderer*)((b2VisWorld*)m_world)->getRenderer())
 #define SET_FILE_OUTPUT_FALSE RENDERER->setFileOutput(false);
-#define SET_FILE_OUTPUT_TRUE(X) RENDERER->setFileOutput((X), m_pSettings->bufferWidth, m_pSettings->bufferHeight);
-#define FINISH_SIMULATION {RENDERER->Finish(); exit(0);};
+#define SET_FILE_OUTPUT_TRUE(X) RENDERER->setFileOutput((X), m_pSettings->bufferWidth, m_pSettings->bufferHeight, m_pSettings->video, m_pSettings->png); \
+	for (const auto& output : m_pSettings->additionalVideoOutputs) RENDERER->addVideoOutput(output.path, output.options); \
+	if (m_pSettings->frameArrayOutputPath != "") RENDERER->setFrameArrayOutput(m_pSettings->frameArrayOutputPath, m_pSettings->frameArrayFps, m_pSettings->video.sourceFps); \
+	if (m_pSettings->frameImageOutputFolder != "") RENDERER->setFrameImageOutput(m_pSettings->frameImageOutputFolder, m_pSettings->frameImageInterval); \
+	if (m_pSettings->instanceMaskOutputFolder != "") RENDERER->setInstanceMaskOutput(m_pSettings->instanceMaskOutputFolder, m_pSettings->instanceMaskInterval); \
+	RENDERER->setYuvReadback(m_pSettings->gpuYuvConversion);
+#define FINISH_SIMULATION {RENDERER->Finish(); m_bFinished = true;};
 
 	// TODO: This class has started to become a God-object, maybe break it apart?
 	class SimulationBase : public Simulation
@@ -46,6 +51,47 @@ namespace svqa {
 	public:
 		typedef std::shared_ptr<SimulationBase> Ptr;
 
+		struct ContactInfo
+		{
+			b2Contact* contact;
+			int step;
+		};
+
+		/// State of a simulation at the end of a step, simulations of the same scene can be resumed from it.
+		/// The scene, the causal graph and the contacts point into its own copy of the world.
+		struct Checkpoint
+		{
+			typedef std::shared_ptr<Checkpoint> Ptr;
+
+			int                             step;
+			std::unique_ptr<b2World>        world;
+			b2Body*                         groundBody;
+			SceneState                      scene;
+			CausalGraph::Ptr                causalGraph;
+			std::vector<ContactInfo>        contacts;
+			std::vector<ContactInfo>        startedTouchingContacts;
+			json                            startSceneState;
+
+			/// Whether the object of the given uniqueID has an event or a contact waiting for one.
+			bool hasTouched(const int& uniqueId) const
+			{
+				for (b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+				{
+					if (((BODY*)b)->getUniqueId() != uniqueId)
+						continue;
+					if (causalGraph->hasEvents((BODY*)b))
+						return true;
+					for (const auto& info : contacts)
+					{
+						if (info.contact->GetFixtureA()->GetBody() == b || info.contact->GetFixtureB()->GetBody() == b)
+							return true;
+					}
+					return false;
+				}
+				return true;
+			}
+		};
+
 		SimulationBase(Settings::Ptr _settings_)
 		{
 			m_bSceneInitialized = false;
@@ -75,7 +121,12 @@ namespace svqa {
 
 				// Generate scene from JSON file if inputScenePath is not blank and the scene is not already generated.
 				if (isGeneratingFromJSON() && !m_bSceneRegenerated) {
-					GenerateSceneFromJson(m_pSettings->inputScenePath);
+					if (!m_InputSceneJSON.is_null()) {
+						m_SceneJSONState.loadFromJSON(m_InputSceneJSON, m_world,
+							m_pSettings->noiseAmount, m_pSettings->perturbationSeed);
+						m_bSceneRegenerated = true;
+					}
+					else GenerateSceneFromJson(m_pSettings->inputScenePath);
 				}
 				else InitializeScene();
 
@@ -96,6 +147,7 @@ namespace svqa {
 			if (shouldTerminateSimulation()) {
 				m_EndSceneStateJSON = SimulationBase::GetSceneStateJSONObject(m_SceneJSONState, m_StepCount);
 				TerminateSimulation();
+				return;
 			}
             
 			DetectStartTouchingEvents();
@@ -137,10 +189,95 @@ namespace svqa {
 			m_bSceneInitialized = value;
 		}
 
+		/// Set once the simulation has terminated and its outputs are written,
+		/// drivers stop stepping after that.
+		bool isFinished() {
+			return m_bFinished;
+		}
+
 		bool isGeneratingFromJSON() {
 			return m_bGeneratingFromJSON;
 		}
 
+		/// Generates the scene from a scene JSON already in memory instead of inputScenePath,
+		/// counterfactual variations build theirs from the start scene of the original.
+		void setInputScene(const json& scene) {
+			m_InputSceneJSON = scene;
+			m_bGeneratingFromJSON = true;
+		}
+
+		/// Causal graph and start and end scene states, set when the simulation has finished.
+		const json& getOutputJSON() const {
+			return m_OutputJSON;
+		}
+
+		int getStepCount() const {
+			return m_StepCount;
+		}
+
+		/// Copies the state at the end of the last step, the simulation must not have finished.
+		/// nullptr if the world cannot be cloned, e.g. when it has joints.
+		Checkpoint::Ptr saveCheckpoint() {
+			std::unique_ptr<b2World> world(m_world->Clone());
+			if (!world)
+				return nullptr;
+
+			Checkpoint::Ptr checkpoint = std::make_shared<Checkpoint>();
+			checkpoint->step = m_StepCount;
+			checkpoint->world = std::move(world);
+			checkpoint->startSceneState = m_StartSceneStateJSON;
+
+			std::map<BODY*, BODY*> bodies;
+			std::map<b2Contact*, b2Contact*> contacts;
+			pairWorlds(m_world, checkpoint->world.get(), bodies, contacts);
+
+			checkpoint->groundBody = bodies.at((BODY*)m_groundBody);
+			checkpoint->scene.cloneFrom(m_SceneJSONState, m_world, (WORLD*)checkpoint->world.get());
+			checkpoint->causalGraph = m_pCausalGraph->clone(bodies);
+			checkpoint->contacts = pairContacts(m_Contacts, contacts);
+			checkpoint->startedTouchingContacts = pairContacts(m_StartedTouchingContacts, contacts);
+			return checkpoint;
+		}
+
+		/// Continues from a checkpoint of a simulation of the same scene instead of the start, with the object
+		/// of the given uniqueID removed. Removing it there is only the same as removing it from the start
+		/// scene if it has not touched anything before the checkpoint.
+		void resumeFromCheckpoint(const Checkpoint& checkpoint, const int& removedObjectId) {
+			m_world->Restore(*checkpoint.world);
+
+			std::map<BODY*, BODY*> bodies;
+			std::map<b2Contact*, b2Contact*> contacts;
+			pairWorlds(checkpoint.world.get(), m_world, bodies, contacts);
+
+			m_groundBody = bodies.at((BODY*)checkpoint.groundBody);
+			m_SceneJSONState.cloneFrom(checkpoint.scene, (WORLD*)checkpoint.world.get(), m_world);
+			m_pCausalGraph = checkpoint.causalGraph->clone(bodies);
+			m_Contacts = pairContacts(checkpoint.contacts, contacts);
+			m_StartedTouchingContacts = pairContacts(checkpoint.startedTouchingContacts, contacts);
+
+			m_StepCount = checkpoint.step;
+			m_StartSceneStateJSON = checkpoint.startSceneState;
+			m_bGeneratingFromJSON = true;
+			m_bSceneRegenerated = true;
+			m_bSceneInitialized = true;
+			m_bSceneSnapshotTaken = true;
+
+			json& startObjects = m_StartSceneStateJSON["scene"]["objects"];
+			for (auto it = startObjects.begin(); it != startObjects.end(); ++it) {
+				if (it->at("uniqueID").get<int>() == removedObjectId) {
+					startObjects.erase(it);
+					break;
+				}
+			}
+			for (b2Body* b = m_world->GetBodyList(); b; b = b->GetNext()) {
+				if (((BODY*)b)->getUniqueId() == removedObjectId) {
+					m_SceneJSONState.remove(b);
+					m_world->DestroyBody(b);
+					break;
+				}
+			}
+		}
+
 		virtual void InitializeScene() = 0;
 
 		virtual bool shouldTerminateSimulation() {
@@ -211,7 +348,10 @@ namespace svqa {
 			output_json.emplace("scene_states", scene_states_json);
 			output_json.emplace("video_filename", m_pSettings->outputVideoPath);
 
-			JSONHelper::saveJSON(output_json, 2, m_pSettings->outputJSONPath);
+			// Variations run in the same process keep their output in memory only.
+			if (m_pSettings->outputJSONPath != "")
+				JSONHelper::saveJSON(output_json, 2, m_pSettings->outputJSONPath);
+			m_OutputJSON = output_json;
 
 			FINISH_SIMULATION
 		}
@@ -272,12 +412,38 @@ namespace svqa {
 		}
 
 	protected:
+		// Pairs the bodies and contacts of a world with those of its copy, which lists them in the same order.
+		static void pairWorlds(b2World* world, b2World* copy, std::map<BODY*, BODY*>& bodies, std::map<b2Contact*, b2Contact*>& contacts)
+		{
+			b2Body* copyBody = copy->GetBodyList();
+			for (b2Body* b = world->GetBodyList(); b && copyBody; b = b->GetNext(), copyBody = copyBody->GetNext())
+			{
+				bodies[(BODY*)b] = (BODY*)copyBody;
+			}
+			b2Contact* copyContact = copy->GetContactList();
+			for (b2Contact* c = world->GetContactList(); c && copyContact; c = c->GetNext(), copyContact = copyContact->GetNext())
+			{
+				contacts[c] = copyContact;
+			}
+		}
+
+		static std::vector<ContactInfo> pairContacts(const std::vector<ContactInfo>& infos, const std::map<b2Contact*, b2Contact*>& contacts)
+		{
+			std::vector<ContactInfo> ret;
+			for (const auto& info : infos)
+			{
+				ret.push_back({ contacts.at(info.contact), info.step });
+			}
+			return ret;
+		}
+
 		Settings::Ptr	m_pSettings;
 		unsigned short	m_nDistinctColorUsed;
 		bool			m_bSceneRegenerated = false;
 		bool			m_bSceneInitialized = false;
 		bool			m_bGeneratingFromJSON = false;
 		bool			m_bSceneSnapshotTaken = false;
+		bool			m_bFinished = false;
         bool            m_bIncludeDynamicObjects = false;
         std::string     m_sStaticObjectOrientationType;
 
@@ -561,12 +727,6 @@ namespace svqa {
 			m_SceneJSONState.add(objectState);
 		}
 
-		struct ContactInfo
-		{
-			b2Contact* contact;
-			int step;
-		};
-
 		std::vector<ContactInfo>    m_Contacts;
 		std::vector<ContactInfo>    m_StartedTouchingContacts;
 
@@ -575,6 +735,8 @@ namespace svqa {
 
 		json						m_StartSceneStateJSON;
 		json						m_EndSceneStateJSON;
+		json						m_InputSceneJSON;
+		json						m_OutputJSON;
 
 	};
 }
@@ -75,19 +75,19 @@ public:
 
     static Size getRandomSize() {
         
-        int i = std::rand() % 2;
+        int i = Random() % 2;
         return Size(i); 
     }
 
     static Color getRandomColor() {
         //RandomFloatFromHardware(15.0, 18.0)
-        int i = std::rand() % 8;
+        int i = Random() % 8;
         return Color(i);
     }
 
     static Shape getRandomShape() {
         
-        int i = std::rand() % 3;
+        int i = Random() % 3;
         return Shape(i);
     }
 
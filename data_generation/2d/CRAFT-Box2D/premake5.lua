@@ -143,6 +143,11 @@ project 'Testbed'
 		{
 			'Box2D',
 			'GL',
+			'EGL',
+			'avformat',
+			'avcodec',
+			'swscale',
+			'avutil',
 			'X11',
 			'Xrandr',
 			'Xinerama',
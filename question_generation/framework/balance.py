@@ -186,7 +186,8 @@ class DatasetBalancer:
         self.__answers_needed = answers_needed
         self.__sid_to_simulation_configs = {simulation_config["id"]: simulation_config for simulation_config in
                                             config.simulation_configs}
-        self.__runner = SimulationRunner(self.config.executable_path)
+        self.__runner = SimulationRunner(self.config.executable_path,
+                                         variation_thread_count=self.config.variation_thread_count)
         self.__video_index = video_index
 
         self.__start_time = None
@@ -692,6 +692,11 @@ class DatasetGenerationConfig:
             # Override default value
             self.concurrent_process_count = config_dict['concurrent_process_count']
 
+        self.variation_thread_count = 1
+        if 'variation_thread_count' in config_dict:
+            # Override default value
+            self.variation_thread_count = config_dict['variation_thread_count']
+
         self.should_generate_questions: bool = True
         if 'do_not_generate_questions' in config_dict:
             # Override default value
@@ -750,7 +755,8 @@ class DatasetGenerator:
     def __init__(self, config: DatasetGenerationConfig):
         self.config = config
         self.__state_file_path = f"{config.output_folder_path}/dataset_generation_state"
-        self.__runner = SimulationRunner(self.config.executable_path, self.config.executable_working_directory)
+        self.__runner = SimulationRunner(self.config.executable_path, self.config.executable_working_directory,
+                                         self.config.variation_thread_count)
         # To measure remaining and elapsed_time.
         self.__start_time = None
         self.__times = np.array([])